@@ -0,0 +1,237 @@
+#! /usr/bin/perl -w
+
+# bench.pl
+#    This program sweeps the io61 test programs across input sizes, block
+#    sizes, strides, and input types (regular file, pipe, socket), running
+#    each against every io61 implementation. It prints one record per run
+#    as CSV (default) or JSON, for tracking performance over time.
+#
+#    Parameters are given as NAME=VALUE arguments (or environment
+#    variables), with comma-separated lists:
+#      PROGRAMS   programs to run (default: all below)
+#      VARIANTS   io61, stdio, syscall, slow (default: all)
+#      TYPES      file, pipe, socket (default: all)
+#      SIZES      input sizes in bytes (default: 65536,4194304,33554432)
+#      BLOCKS     block sizes for -b programs (default: 1,512,4096,65536)
+#      STRIDES    strides for stridecat61 (default: 1024,65536)
+#      TRIALS     runs per configuration; the fastest is reported (default: 1)
+#      SLOWMAX    largest input given to the slow variant (default: 1048576)
+#      FORMAT     csv or json (default: csv)
+#      OUT        output file (default: standard output)
+#
+#    Example: perl bench.pl PROGRAMS=cat61,blockcat61 TYPES=pipe FORMAT=json
+
+use Time::HiRes;
+use POSIX;
+use List::Util qw(min);
+
+my %param;
+foreach my $arg (@ARGV) {
+    if ($arg =~ /\A([A-Z]+)=(.*)\z/s) {
+        $param{$1} = $2;
+    } else {
+        die "Usage: perl bench.pl [NAME=VALUE]...\n";
+    }
+}
+
+sub param ($$) {
+    my ($name, $default) = @_;
+    return $param{$name} if exists($param{$name});
+    return $ENV{$name} if exists($ENV{$name}) && $ENV{$name} ne "";
+    return $default;
+}
+
+sub list_param ($$) {
+    return split(/[\s,]+/, param($_[0], $_[1]));
+}
+
+
+# PROGRAMS
+#    Each program lists the arguments it is run with (`%b` is replaced
+#    by the block size and `%t` by the stride) and the input types it
+#    supports. Programs that seek need a regular file.
+
+my %programs = (
+    "cat61" => ["", "file pipe socket"],
+    "blockcat61" => ["-b %b", "file pipe socket"],
+    "randblockcat61" => ["-b %b", "file pipe socket"],
+    "scattergather61" => ["-b %b", "file pipe socket"],
+    "reordercat61" => ["-b %b", "file"],
+    "stridecat61" => ["-b %b -t %t", "file"],
+    "reverse61" => ["", "file"],
+);
+my @program_order = qw(cat61 blockcat61 randblockcat61 scattergather61
+                       reordercat61 stridecat61 reverse61);
+
+my @PROGRAMS = list_param("PROGRAMS", join(",", @program_order));
+my @VARIANTS = list_param("VARIANTS", "io61,stdio,syscall,slow");
+my @TYPES = list_param("TYPES", "file,pipe,socket");
+my @SIZES = list_param("SIZES", "65536,4194304,33554432");
+my @BLOCKS = list_param("BLOCKS", "1,512,4096,65536");
+my @STRIDES = list_param("STRIDES", "1024,65536");
+my $TRIALS = param("TRIALS", 1);
+my $SLOWMAX = param("SLOWMAX", 1048576);
+my $FORMAT = param("FORMAT", "csv");
+my $OUTFILE = param("OUT", undef);
+
+foreach my $p (@PROGRAMS) {
+    die "bench.pl: unknown program $p\n" if !exists($programs{$p});
+}
+my %prefix = ("io61" => "", "stdio" => "stdio-", "syscall" => "syscall-",
+              "slow" => "slow-");
+foreach my $v (@VARIANTS) {
+    die "bench.pl: unknown variant $v\n" if !exists($prefix{$v});
+}
+die "bench.pl: FORMAT must be csv or json\n" if $FORMAT !~ /\A(?:csv|json)\z/;
+
+
+# Build the programs and inputs
+
+my @targets = ("socketpipe");
+foreach my $p (@PROGRAMS) {
+    push @targets, map { $prefix{$_} . $p } @VARIANTS;
+}
+system("make", "-s", @targets) == 0 or die "bench.pl: build failed\n";
+
+mkdir("files");
+my $outpath = "files/bench-out.txt";
+
+sub make_input ($) {
+    my ($size) = @_;
+    my ($fn) = "files/bench-$size.txt";
+    if (!-r $fn || -s $fn != $size) {
+        open(my $src, "<", "/usr/share/dict/words") or die "/usr/share/dict/words: $!\n";
+        my $words = join("", <$src>);
+        close($src);
+        open(my $dst, ">", $fn) or die "$fn: $!\n";
+        my $n = 0;
+        while ($n < $size) {
+            my $chunk = substr($words, 0, min(length($words), $size - $n));
+            print $dst $chunk;
+            $n += length($chunk);
+        }
+        close($dst);
+    }
+    return $fn;
+}
+
+
+# run_one(command)
+#    Runs `command` with io61 statistics enabled and returns the hash
+#    reported on file descriptor 100 (plus wall-clock `time` if the
+#    program reported nothing).
+
+sub run_one ($) {
+    my ($command) = @_;
+    my $timing = "files/bench-timing.json";
+    unlink($timing);
+    local $ENV{"IO61_STATS"} = 1;
+    my $before = Time::HiRes::time();
+    # (POSIX sh need not support file descriptors above 9)
+    my $status = system("bash", "-c", "{ $command; } 100>$timing");
+    my %r = ("time" => Time::HiRes::time() - $before, "status" => $status);
+    if (open(my $fh, "<", $timing)) {
+        my $text = join("", <$fh>);
+        close($fh);
+        while ($text =~ m/\"(\w+)\"\s*:\s*([\d.]+)/g) {
+            $r{$1} = $2;
+        }
+    }
+    return \%r;
+}
+
+
+# Run the matrix
+
+my @columns = qw(program variant type size block stride time utime stime
+                 maxrss mbps syscalls requests hits ok);
+my @records;
+
+sub emit (\%) {
+    my ($rec) = @_;
+    push @records, $rec;
+    if ($FORMAT eq "csv") {
+        print OUT join(",", map { $rec->{$_} } @columns), "\n";
+    }
+}
+
+if (defined($OUTFILE)) {
+    open(OUT, ">", $OUTFILE) or die "$OUTFILE: $!\n";
+} else {
+    open(OUT, ">&", \*STDOUT) or die;
+}
+print OUT join(",", @columns), "\n" if $FORMAT eq "csv";
+
+foreach my $p (@PROGRAMS) {
+    my ($argpattern, $types) = @{$programs{$p}};
+    my @blocks = $argpattern =~ /%b/ ? @BLOCKS : ("");
+    my @strides = $argpattern =~ /%t/ ? @STRIDES : ("");
+    foreach my $size (@SIZES) {
+        my $infile = make_input($size);
+        foreach my $type (@TYPES) {
+            next if $types !~ /\b$type\b/;
+            foreach my $block (@blocks) {
+                # reordercat61 needs whole blocks
+                next if $p eq "reordercat61" && ($block > $size || $size % $block);
+                foreach my $stride (@strides) {
+                    my $args = $argpattern;
+                    $args =~ s/%b/$block/g;
+                    $args =~ s/%t/$stride/g;
+                    foreach my $v (@VARIANTS) {
+                        next if $v eq "slow" && $size > $SLOWMAX;
+                        my $prog = "./$prefix{$v}$p $args";
+                        my $command;
+                        if ($type eq "file") {
+                            $command = "$prog -o $outpath $infile";
+                        } elsif ($type eq "pipe") {
+                            $command = "cat $infile | $prog | cat > $outpath";
+                        } else {
+                            $command = "./socketpipe cat $infile \"|\" $prog > $outpath";
+                        }
+
+                        my $best;
+                        for (my $trial = 0; $trial < $TRIALS; ++$trial) {
+                            my $r = run_one($command);
+                            $best = $r if !defined($best) || $r->{"time"} < $best->{"time"};
+                        }
+                        my $t = $best->{"time"};
+                        # the stdio variant cannot see stdio's system
+                        # calls, so its counters are left empty
+                        my $counted = $v ne "stdio";
+                        my %rec = (
+                            "program" => $p, "variant" => $v, "type" => $type,
+                            "size" => $size, "block" => $block, "stride" => $stride,
+                            "time" => sprintf("%.6f", $t),
+                            "utime" => $best->{"utime"} // "",
+                            "stime" => $best->{"stime"} // "",
+                            "maxrss" => $best->{"maxrss"} // "",
+                            "mbps" => sprintf("%.1f", $t > 0 ? $size / $t / 1048576 : 0),
+                            "syscalls" => !$counted ? ""
+                                : ($best->{"reads"} // 0) + ($best->{"writes"} // 0)
+                                  + ($best->{"seeks"} // 0) + ($best->{"maps"} // 0)
+                                  + ($best->{"copies"} // 0),
+                            "requests" => $counted ? $best->{"requests"} // 0 : "",
+                            "hits" => $counted ? $best->{"hits"} // 0 : "",
+                            "ok" => ($best->{"status"} == 0 && (-s $outpath // 0) == $size) ? 1 : 0
+                        );
+                        emit(%rec);
+                    }
+                }
+            }
+        }
+    }
+}
+
+if ($FORMAT eq "json") {
+    print OUT "[\n";
+    for (my $i = 0; $i < @records; ++$i) {
+        my $rec = $records[$i];
+        print OUT "  {", join(", ", map {
+            my $x = $rec->{$_};
+            "\"$_\": " . ($x =~ /\A-?\d+(?:\.\d+)?\z/ ? $x : "\"$x\"")
+        } @columns), "}", ($i + 1 < @records ? "," : ""), "\n";
+    }
+    print OUT "]\n";
+}
+close(OUT);
+unlink($outpath, "files/bench-timing.json");
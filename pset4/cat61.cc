@@ -5,7 +5,7 @@
 
 int main(int argc, char* argv[]) {
     // Parse arguments
-    io61_args args = io61_args("s:o:i:D:a:Fy").parse(argc, argv);
+    io61_args args = io61_args("s:o:i:D:a:B:XMFy").parse(argc, argv);
 
     io61_file* inf = io61_open_check(args.input_file, O_RDONLY);
     io61_file* outf = io61_open_check(args.output_file,
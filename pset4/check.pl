@@ -1247,6 +1247,61 @@ enqueue("C22",
     "unmappable file, byte I/O, reverse order",
     "perf" => 0, "compare" => -1, "insize" => 4096);
 
+enqueue("C23",
+    "./copy61 -b 1021 -o outputs/out.txt $texttiny",
+    "1021B io61_copy, sequential correctness",
+    "perf" => 0, "expect" => $texttiny);
+
+enqueue("C24",
+    "cat $textsm | ./copy61 -b 4093 | cat > outputs/out.txt",
+    "4093B io61_copy, piped, sequential correctness",
+    "perf" => 0, "expect" => $textsm);
+
+enqueue("C25",
+    "./vectorcat61 -b 37 -o outputs/out.txt $texttiny",
+    "1-37B vectored I/O, sequential correctness",
+    "perf" => 0, "expect" => $texttiny);
+
+enqueue("C26",
+    "cat $textsm | ./vectorcat61 -b 2048 | cat > outputs/out.txt",
+    "1B-2KB vectored I/O, piped, sequential correctness",
+    "perf" => 0, "expect" => $textsm);
+
+enqueue("C27",
+    "cat $textsm | ./pollcat61 -b 4093 | cat > outputs/out.txt",
+    "4093B nonblocking I/O, piped, sequential correctness",
+    "perf" => 0, "expect" => $textsm);
+
+enqueue("C28",
+    "./pollcat61 -b 509 -i $textsm -o outputs/c28a.txt -i $revtextsm -o outputs/c28b.txt",
+    "nonblocking I/O, 2 files, 509B blocks, sequential",
+    "perf" => 0, "compare" => 1);
+
+enqueue("C29",
+    "./parcopy61 -j 4 -b 4093 -o outputs/out.txt $textlg",
+    "4-thread chunked copy, 4093B block I/O, correctness",
+    "perf" => 0, "expect" => $textlg);
+
+enqueue("C30",
+    "./blockcat61 -X -b 4093 -o outputs/out.txt $textlg",
+    "direct I/O, 4093B block I/O, sequential correctness",
+    "perf" => 0, "expect" => $textlg);
+
+enqueue("C31",
+    "./cat61 -X $textmd > outputs/out.txt",
+    "direct I/O, byte I/O, redirected output correctness",
+    "perf" => 0, "expect" => $textmd);
+
+enqueue("C32",
+    "./socketpipe cat $textlg '|' ./copy61 -p 1 -o outputs/out.txt",
+    "io61_copy from a larger input cache, socket to file, correctness",
+    "perf" => 0, "expect" => $textlg);
+
+enqueue("C33",
+    "./tally61 -j 4 -o outputs/out.txt $textmd",
+    "4 threads sharing one file, byte I/O, correctness",
+    "perf" => 0, "compare" => 1);
+
 
 # REGULAR FILES, SEQUENTIAL I/O
 enqueue("MSEQ1",
@@ -1278,6 +1333,18 @@ enqueue("MSEQ7",
     "./blockcat61 -b 1024 $textmd | cat > outputs/out.txt",
     "mixed-piped medium file, 1KB block I/O, sequential");
 
+enqueue("MSEQ8",
+    "./copy61 -o outputs/out.txt $textmd",
+    "regular medium file, 1MB io61_copy, sequential");
+
+enqueue("MSEQ9",
+    "./vectorcat61 -o outputs/out.txt $textmd",
+    "regular medium file, 1-64B vectored I/O, sequential");
+
+enqueue("MSEQ10",
+    "./scattergather61 -b 4096 -l -o outputs/out.txt $textmd",
+    "regular medium file, line I/O, sequential");
+
 
 
 # NONSEQUENTIAL
@@ -1338,6 +1405,22 @@ enqueue("LSEQ9",
     "./randblockcat61 $textlg > outputs/out.txt",
     "redirected large file, 1B-4KB block I/O, sequential");
 
+enqueue("LSEQ10",
+    "./copy61 -o outputs/out.txt $textlg",
+    "regular large file, 1MB io61_copy, sequential");
+
+enqueue("LSEQ11",
+    "cat $textlg | ./copy61 | cat > outputs/out.txt",
+    "piped large file, 1MB io61_copy, sequential");
+
+enqueue("LSEQ12",
+    "cat $textlg | ./vectorcat61 -b 4096 | cat > outputs/out.txt",
+    "piped large file, 1B-4KB vectored I/O, sequential");
+
+enqueue("LSEQ13",
+    "cat $textlg | ./scattergather61 -b 4096 -l | cat > outputs/out.txt",
+    "piped large file, line I/O, sequential");
+
 enqueue("LNONSEQ1",
     "./reverse61 -s 8388608 -o outputs/out.txt $textlg",
     "regular large file, byte I/O, reverse order");
@@ -1351,6 +1434,63 @@ enqueue("LNONSEQ3",
     "regular large file, 4KB block I/O, random seek order");
 
 
+# BLOCK SIZE SWEEP
+#    Requests of at least one cache buffer bypass the cache; compare
+#    these against LSEQ8 to find the crossover.
+
+my ($blkn) = 0;
+foreach my $bs (8192, 16384, 65536, 262144, 1048576) {
+    ++$blkn;
+    enqueue("BLK$blkn",
+        "cat $textlg | ./blockcat61 -b $bs -o outputs/out.txt",
+        "mixed-piped large file, " . ($bs >= 1048576 ? ($bs >> 20) . "MB" : ($bs >> 10) . "KB") . " block I/O, sequential");
+}
+
+
+# NONBLOCKING I/O
+#    pollcat61 drives nonblocking pipes through io61_poll. Compare NB1
+#    with LSEQ6.
+
+enqueue("NB1", "cat $textlg | ./pollcat61 | cat > outputs/out.txt",
+        "piped large file, nonblocking 4KB block I/O, sequential");
+
+# PARALLEL COPY
+#    parcopy61 copies chunks of the input with one thread per CPU.
+#    Compare PAR1 with PAR2.
+
+enqueue("PAR1", "./parcopy61 -j 1 -o outputs/out.txt $textlg",
+        "regular large file, 1-thread chunked copy");
+enqueue("PAR2", "./parcopy61 -o outputs/out.txt $textlg",
+        "regular large file, parallel chunked copy");
+
+# DIRECT I/O
+#    `-X` bypasses the page cache. Compare DIO1 with DIO2.
+
+enqueue("DIO1", "./blockcat61 -b 65536 -o outputs/out.txt $textlg",
+        "regular large file, 64KB block I/O, page cache");
+enqueue("DIO2", "./blockcat61 -X -b 65536 -o outputs/out.txt $textlg",
+        "regular large file, 64KB block I/O, direct I/O");
+
+# FLUSHING
+#    `-F` calls io61_flush after every block. Compare FLUSH1 with LSEQ2.
+
+enqueue("FLUSH1", "./blockcat61 -F -b 4096 -o outputs/out.txt $textlg",
+        "regular large file, 4KB block I/O, flush after every block");
+
+# BUFFER SIZE AUTOTUNING
+#    io61_fdopen sizes its cache from the file type; `-B 8192` forces the
+#    old fixed 8KB cache. `-M` turns off memory mapping, so that regular
+#    files go through the cache. Compare BUF1 with BUF2, and BUF3 with
+#    LSEQ5.
+
+enqueue("BUF1", "./cat61 -M -B 8192 -o outputs/out.txt $textlg",
+        "large file, byte I/O, no mapping, fixed 8KB buffer");
+enqueue("BUF2", "./cat61 -M -o outputs/out.txt $textlg",
+        "large file, byte I/O, no mapping, autotuned buffer");
+enqueue("BUF3", "cat $textlg | ./cat61 -B 8192 | cat > outputs/out.txt",
+        "piped large file, byte I/O, fixed 8KB buffer");
+
+
 run();
 
 summary();
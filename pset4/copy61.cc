@@ -0,0 +1,42 @@
+#include "io61.hh"
+
+// Usage: ./copy61 [-b BLOCKSIZE] [-s SIZE] [-p POSITION] [-o OUTFILE] [FILE]
+//    Copies the input FILE to OUTFILE with `io61_copy`, transferring
+//    at most BLOCKSIZE bytes per call. Default BLOCKSIZE is 1MiB. The
+//    first POSITION bytes are copied a character at a time, so the
+//    first `io61_copy` starts with cached input.
+
+int main(int argc, char* argv[]) {
+    // Parse arguments
+    io61_args args = io61_args("b:s:p:o:i:D:Fy", 1 << 20).parse(argc, argv);
+
+    // Open files
+    io61_file* inf = io61_open_check(args.input_file, O_RDONLY);
+    io61_file* outf = io61_open_check(args.output_file,
+                                      O_WRONLY | O_CREAT | O_TRUNC);
+    args.after_open(inf, O_RDONLY);
+    args.after_open(outf, O_WRONLY);
+
+    // Copy file data
+    for (size_t i = 0; i != args.initial_offset && args.file_size != 0; ++i) {
+        int ch = io61_readc(inf);
+        if (ch == EOF) {
+            break;
+        }
+        io61_writec(outf, ch);
+        --args.file_size;
+    }
+    while (args.file_size != 0) {
+        ssize_t nc = io61_copy(inf, outf,
+                               std::min(args.block_size, args.file_size));
+        if (nc <= 0) {
+            break;
+        }
+        args.file_size -= nc;
+
+        args.after_write(outf);
+    }
+
+    io61_close(inf);
+    io61_close(outf);
+}
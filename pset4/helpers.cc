@@ -158,6 +158,21 @@ io61_args& io61_args::parse(int argc, char** argv) {
             if (endptr == optarg || *endptr) {
                 goto usage;
             }
+            io61_set_buffer_size(this->pipebuf_size);
+            break;
+        case 'X':
+            this->direct = true;
+            io61_set_direct(true);
+            break;
+        case 'M':
+            this->nommap = true;
+            io61_set_mmap(false);
+            break;
+        case 'j':
+            this->nthreads = (unsigned) strtoul(optarg, &endptr, 0);
+            if (this->nthreads == 0 || endptr == optarg || *endptr) {
+                goto usage;
+            }
             break;
         case '#':
         default:
@@ -242,7 +257,16 @@ void io61_args::usage() {
         fprintf(stderr, "    -y            Yield after each write\n");
     }
     if (strchr(this->opts, 'B')) {
-        fprintf(stderr, "    -B BUFSIZ     Set input pipe buffer size on Linux\n");
+        fprintf(stderr, "    -B BUFSIZ     Set io61 buffer size (and input pipe buffer size on Linux)\n");
+    }
+    if (strchr(this->opts, 'X')) {
+        fprintf(stderr, "    -X            Use direct I/O (O_DIRECT) for regular files\n");
+    }
+    if (strchr(this->opts, 'M')) {
+        fprintf(stderr, "    -M            Do not memory-map files (use the io61 cache)\n");
+    }
+    if (strchr(this->opts, 'j')) {
+        fprintf(stderr, "    -j THREADS    Set number of threads (default: one per CPU)\n");
     }
     if (strchr(this->opts, 'r')) {
         fprintf(stderr, "    -r            Set random seed (default %u)\n", this->seed);
@@ -334,7 +358,9 @@ io61_profiler::io61_profiler() {
 
 io61_profiler::~io61_profiler() {
     // Measure elapsed real, user, and system times, and report the result
-    // as JSON to file descriptor 100 if it’s available.
+    // as JSON to file descriptor 100 if it’s available. If the `IO61_STATS`
+    // environment variable is set, also report the io61_stats totals for
+    // all closed files.
 
     double real_elapsed = monotonic_timestamp() - this->begin_at;
 
@@ -355,11 +381,23 @@ io61_profiler::~io61_profiler() {
 
     char buf[1000];
     ssize_t len = snprintf(buf, sizeof(buf),
-        "{\"time\":%.6f, \"utime\":%ld.%06ld, \"stime\":%ld.%06ld, \"maxrss\":%ld}\n",
+        "{\"time\":%.6f, \"utime\":%ld.%06ld, \"stime\":%ld.%06ld, \"maxrss\":%ld",
         real_elapsed,
         usage.ru_utime.tv_sec, (long) usage.ru_utime.tv_usec,
         usage.ru_stime.tv_sec, (long) usage.ru_stime.tv_usec,
         maxrss);
+    if (getenv("IO61_STATS")) {
+        io61_statistics st = io61_stats(nullptr);
+        len += snprintf(buf + len, sizeof(buf) - len,
+            ", \"io61\":{\"requested\":%zu, \"transferred\":%zu, "
+            "\"requests\":%lu, \"hits\":%lu, \"reads\":%lu, \"writes\":%lu, "
+            "\"seeks\":%lu, \"maps\":%lu, \"copies\":%lu, \"flushes\":%lu, "
+            "\"blocked\":%.6f}",
+            st.nrequested, st.ntransferred, st.nrequests, st.nhits,
+            st.nreads, st.nwrites, st.nseeks, st.nmaps, st.ncopies,
+            st.nflushes, st.blocked);
+    }
+    len += snprintf(buf + len, sizeof(buf) - len, "}\n");
 
     off_t off = lseek(100, 0, SEEK_CUR);
     int fd = (off != (off_t) -1 || errno == ESPIPE ? 100 : STDERR_FILENO);
@@ -9,10 +9,33 @@
 #include <unistd.h>
 #include <fcntl.h>
 #include <sched.h>
+#include <poll.h>
+#include <sys/uio.h>
 
 struct io61_file;
 
+
+// io61_fastbuf
+//    Every io61_file begins with an io61_fastbuf. When `rpos < rend`, the
+//    next bytes to read are available at `rpos`; when `wpos < wend`, the
+//    next bytes written may be stored at `wpos`. The inline io61_readc and
+//    io61_writec below use these windows without a function call or a
+//    lock; everything else goes through io61_readc_slow/io61_writec_slow.
+//    An implementation that leaves the pointers null always takes the
+//    slow path. Files shared between threads (io61_set_shared) never
+//    expose a window.
+
+struct io61_fastbuf {
+    unsigned char* rpos = nullptr;      // next byte to read
+    unsigned char* rend = nullptr;      // end of readable window
+    unsigned char* wpos = nullptr;      // next byte to write
+    unsigned char* wend = nullptr;      // end of writable window
+};
+
 io61_file* io61_fdopen(int fd, int mode);
+void io61_set_buffer_size(size_t sz);
+void io61_set_direct(bool direct);
+void io61_set_mmap(bool mmap);
 io61_file* io61_open_check(const char* filename, int mode);
 int io61_fileno(io61_file* f);
 int io61_close(io61_file* f);
@@ -21,16 +44,86 @@ off_t io61_filesize(io61_file* f);
 
 int io61_seek(io61_file* f, off_t off);
 
-int io61_readc(io61_file* f);
-int io61_writec(io61_file* f, int c);
+void io61_set_shared(io61_file* f, bool shared);
+
+int io61_readc_slow(io61_file* f);
+int io61_writec_slow(io61_file* f, int c);
+
+// io61_readc(f), io61_writec(f, c)
+//    Inline fast paths. `io61_file` is incomplete here, so the compiler
+//    cannot `static_cast` it to its io61_fastbuf base; the
+//    `reinterpret_cast` assumes that base sits at offset 0. C++ does not
+//    promise that for classes that are not standard-layout, so every
+//    io61_fdopen asserts it.
+
+inline int io61_readc(io61_file* f) {
+    io61_fastbuf* fb = reinterpret_cast<io61_fastbuf*>(f);
+    if (fb->rpos < fb->rend) {
+        return *fb->rpos++;
+    }
+    return io61_readc_slow(f);
+}
+
+inline int io61_writec(io61_file* f, int c) {
+    io61_fastbuf* fb = reinterpret_cast<io61_fastbuf*>(f);
+    if (fb->wpos < fb->wend) {
+        *fb->wpos++ = c;
+        return 0;
+    }
+    return io61_writec_slow(f, c);
+}
 
 int io61_fill(io61_file* f); 
 ssize_t io61_read(io61_file* f, unsigned char* buf, size_t sz);
 ssize_t io61_write(io61_file* f, const unsigned char* buf, size_t sz);
+ssize_t io61_readuntil(io61_file* f, const unsigned char** bufp, size_t sz,
+                       int delim);
+ssize_t io61_getline(io61_file* f, const unsigned char** bufp);
+ssize_t io61_readv(io61_file* f, const struct iovec* iov, int iovcnt);
+ssize_t io61_writev(io61_file* f, const struct iovec* iov, int iovcnt);
+ssize_t io61_copy(io61_file* in, io61_file* out, size_t sz);
 
 int io61_flush(io61_file* f);
 int io61_slot_flush(io61_file* f, int slot); 
 
+// io61_pollfd, io61_poll(pfds, n, timeout)
+//    Like poll(2), but for io61 files. An entry is ready for POLLIN if a
+//    read would return data (or end of file) without blocking, and ready
+//    for POLLOUT if a write would be accepted without blocking; data
+//    already in an io61 cache counts. Returns the number of ready
+//    entries, 0 on timeout, or -1 on error.
+
+struct io61_pollfd {
+    io61_file* f;
+    short events;                       // POLLIN and/or POLLOUT
+    short revents;                      // set by io61_poll
+};
+
+int io61_poll(io61_pollfd* pfds, size_t n, int timeout);
+
+// io61_statistics, io61_stats(f)
+//    Per-file I/O counters. `io61_stats(f)` returns the counts for `f` so
+//    far; `io61_stats(nullptr)` returns the totals for all files closed so
+//    far. An implementation counts only what it can see (the stdio version
+//    counts nothing). `nhits / nrequests` is the cache hit rate; every
+//    byte moved by an inline io61_readc/io61_writec is a hit.
+
+struct io61_statistics {
+    size_t nrequested = 0;              // bytes the caller read or wrote
+    size_t ntransferred = 0;            // bytes moved by system calls
+    unsigned long nrequests = 0;        // read and write requests
+    unsigned long nhits = 0;            // requests needing no system call
+    unsigned long nreads = 0;           // read system calls
+    unsigned long nwrites = 0;          // write system calls
+    unsigned long nseeks = 0;           // lseek system calls
+    unsigned long nmaps = 0;            // mmap/mremap/munmap/msync calls
+    unsigned long ncopies = 0;          // in-kernel copy system calls
+    unsigned long nflushes = 0;         // io61_flush calls
+    double blocked = 0;                 // seconds spent in system calls
+};
+
+io61_statistics io61_stats(io61_file* f);
+
 int fd_open_check(const char* filename, int mode);
 FILE* stdio_open_check(const char* filename, int mode);
 
@@ -53,8 +146,11 @@ struct io61_args {
     std::mt19937 engine;                // source of randomness
     unsigned seed;                      // `-r`: random seed
     double delay = 0.0;                 // `-D`: delay
-    size_t pipebuf_size = 0;            // `-B`: pipe buffer size
+    size_t pipebuf_size = 0;            // `-B`: io61 and pipe buffer size
     bool nonblocking = false;           // `-n`: nonblocking
+    unsigned nthreads = 0;              // `-j`: number of threads
+    bool direct = false;                // `-X`: direct I/O
+    bool nommap = false;                // `-M`: no memory mapping
 
     explicit io61_args(const char* opts, size_t block_size = 0);
 
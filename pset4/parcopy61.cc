@@ -0,0 +1,145 @@
+#include "io61.hh"
+#include <sys/stat.h>
+#include <deque>
+#include <mutex>
+#include <thread>
+
+// Usage: ./parcopy61 [-j THREADS] [-b BLOCKSIZE] -o OUTFILE FILE
+//    Copies the input FILE to OUTFILE using several threads. The file is
+//    split into chunks; each thread starts with its own contiguous run of
+//    chunks and, when that runs out, steals chunks from the far end of
+//    another thread's run. Every thread opens its own io61 files, so
+//    threads never contend for an io61 lock. Data moves in BLOCKSIZE
+//    pieces (default 64KiB).
+//
+//    If FILE is not a seekable regular file, or there is no OUTFILE,
+//    parcopy61 copies sequentially in a single thread.
+
+static constexpr size_t chunk_size = 8 << 20;
+
+struct chunk_queue {
+    std::mutex m;
+    std::deque<size_t> chunks;      // chunk numbers, in file order
+};
+
+static std::vector<chunk_queue> queues;
+
+
+// next_chunk(self, chunk)
+//    Takes the next chunk for thread `self`: the front of its own queue,
+//    or else the back of another thread's queue. Returns false when no
+//    work is left.
+
+static bool next_chunk(size_t self, size_t* chunk) {
+    for (size_t i = 0; i != queues.size(); ++i) {
+        chunk_queue& q = queues[(self + i) % queues.size()];
+        std::unique_lock<std::mutex> guard(q.m);
+        if (!q.chunks.empty()) {
+            if (i == 0) {
+                *chunk = q.chunks.front();
+                q.chunks.pop_front();
+            } else {
+                *chunk = q.chunks.back();
+                q.chunks.pop_back();
+            }
+            return true;
+        }
+    }
+    return false;
+}
+
+
+// copy_blocks(inf, outf, buf, bufsz, sz)
+//    Copies up to `sz` bytes from `inf` to `outf` through `buf`. Returns
+//    false on a read or write error.
+
+static bool copy_blocks(io61_file* inf, io61_file* outf,
+                        unsigned char* buf, size_t bufsz, size_t sz) {
+    while (sz != 0) {
+        ssize_t nr = io61_read(inf, buf, std::min(bufsz, sz));
+        if (nr <= 0) {
+            return nr == 0;
+        }
+        if (io61_write(outf, buf, nr) != nr) {
+            return false;
+        }
+        sz -= nr;
+    }
+    return true;
+}
+
+
+static void copy_thread(const io61_args* args, size_t self, size_t size) {
+    io61_file* inf = io61_open_check(args->input_file, O_RDONLY);
+    io61_file* outf = io61_fdopen(fd_open_check(args->output_file, O_WRONLY),
+                                  O_WRONLY);
+    std::vector<unsigned char> buf(args->block_size);
+
+    size_t chunk;
+    while (next_chunk(self, &chunk)) {
+        off_t off = chunk * chunk_size;
+        if (io61_seek(inf, off) == -1
+            || io61_seek(outf, off) == -1
+            || !copy_blocks(inf, outf, buf.data(), buf.size(),
+                            std::min(chunk_size, size - off))) {
+            perror("parcopy61");
+            exit(1);
+        }
+    }
+
+    io61_close(inf);
+    io61_close(outf);
+}
+
+
+int main(int argc, char* argv[]) {
+    // Parse arguments
+    io61_args args = io61_args("j:b:o:i:", 65536).parse(argc, argv);
+    if (args.nthreads == 0) {
+        args.nthreads = std::max(std::thread::hardware_concurrency(), 1U);
+    }
+
+    // Can this file be copied in parallel?
+    io61_file* inf = io61_open_check(args.input_file, O_RDONLY);
+    struct stat s;
+    bool parallel = args.input_file && args.output_file
+        && fstat(io61_fileno(inf), &s) == 0 && S_ISREG(s.st_mode);
+
+    if (!parallel) {
+        io61_file* outf = io61_open_check(args.output_file,
+                                          O_WRONLY | O_CREAT | O_TRUNC);
+        std::vector<unsigned char> buf(args.block_size);
+        bool ok = copy_blocks(inf, outf, buf.data(), buf.size(), SIZE_MAX);
+        io61_close(inf);
+        io61_close(outf);
+        return ok ? 0 : 1;
+    }
+    io61_close(inf);
+
+    // Size the output, then deal out the chunks
+    size_t size = s.st_size;
+    int fd = fd_open_check(args.output_file, O_WRONLY | O_CREAT | O_TRUNC);
+    if (ftruncate(fd, size) == -1) {
+        perror("parcopy61");
+        exit(1);
+    }
+    close(fd);
+
+    size_t nchunks = (size + chunk_size - 1) / chunk_size;
+    size_t nthreads = std::min((size_t) args.nthreads, std::max(nchunks, (size_t) 1));
+    queues = std::vector<chunk_queue>(nthreads);
+    for (size_t i = 0; i != nthreads; ++i) {
+        for (size_t c = i * nchunks / nthreads; c != (i + 1) * nchunks / nthreads; ++c) {
+            queues[i].chunks.push_back(c);
+        }
+    }
+
+    // Copy file data
+    std::vector<std::thread> threads;
+    for (size_t i = 0; i != nthreads; ++i) {
+        threads.emplace_back(copy_thread, &args, i, size);
+    }
+    for (auto& t : threads) {
+        t.join();
+    }
+}
@@ -0,0 +1,117 @@
+#include "io61.hh"
+#include <vector>
+
+// Usage: ./pollcat61 [-b BLOCKSIZE] [-i IFILE -o OFILE]...
+//    Copies each IFILE to the corresponding OFILE in blocks. All files
+//    are nonblocking; a single thread uses io61_poll to move data for
+//    whichever copies are ready, so a stalled input or output never
+//    holds up the others. Default BLOCKSIZE is 4096.
+
+struct transfer {
+    io61_file* inf;
+    io61_file* outf;
+    std::vector<unsigned char> buf;
+    size_t pos = 0;             // next byte of `buf` to write
+    size_t len = 0;             // end of data in `buf`
+    bool eof = false;           // has `inf` reached end of file?
+    bool flushing = false;      // must `outf` be flushed?
+
+    bool done() const {
+        return this->eof && this->pos == this->len && !this->flushing;
+    }
+};
+
+static bool retry() {
+    return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+}
+
+
+int main(int argc, char* argv[]) {
+    // Parse arguments
+    io61_args args = io61_args("b:i:o:B:Fy##", 4096).parse(argc, argv);
+    if (args.input_files.size() != args.output_files.size()) {
+        fprintf(stderr, "%s: need one -o OFILE per input\n", argv[0]);
+        exit(1);
+    }
+    args.nonblocking = true;
+
+    // Open files
+    std::vector<transfer> xfers(args.input_files.size());
+    for (size_t i = 0; i != xfers.size(); ++i) {
+        xfers[i].inf = io61_open_check(args.input_files[i], O_RDONLY);
+        xfers[i].outf = io61_open_check(args.output_files[i],
+                                        O_WRONLY | O_CREAT | O_TRUNC);
+        xfers[i].buf.resize(args.block_size);
+        args.after_open(xfers[i].inf, O_RDONLY);
+        args.after_open(xfers[i].outf, O_WRONLY);
+    }
+
+    // Copy file data
+    std::vector<io61_pollfd> pfds;
+    std::vector<transfer*> waiting;
+    while (true) {
+        pfds.clear();
+        waiting.clear();
+        for (auto& x : xfers) {
+            if (x.done()) {
+                continue;
+            } else if (x.pos != x.len || x.flushing) {
+                pfds.push_back({x.outf, POLLOUT, 0});
+            } else {
+                pfds.push_back({x.inf, POLLIN, 0});
+            }
+            waiting.push_back(&x);
+        }
+        if (pfds.empty()) {
+            break;
+        }
+
+        int r = io61_poll(pfds.data(), pfds.size(), -1);
+        if (r == -1 && errno != EINTR) {
+            perror("io61_poll");
+            exit(1);
+        }
+
+        for (size_t i = 0; r > 0 && i != pfds.size(); ++i) {
+            transfer& x = *waiting[i];
+            if (!pfds[i].revents) {
+                continue;
+            } else if (x.pos != x.len) {
+                ssize_t nw = io61_write(x.outf, &x.buf[x.pos], x.len - x.pos);
+                if (nw > 0) {
+                    x.pos += nw;
+                    if (x.pos == x.len) {
+                        x.flushing = args.flush;
+                        args.after_write(x.outf);
+                    }
+                } else if (!retry()) {
+                    perror("io61_write");
+                    exit(1);
+                }
+            } else if (x.flushing) {
+                if (io61_flush(x.outf) == 0) {
+                    x.flushing = false;
+                } else if (!retry()) {
+                    perror("io61_flush");
+                    exit(1);
+                }
+            } else {
+                ssize_t nr = io61_read(x.inf, x.buf.data(), x.buf.size());
+                if (nr > 0) {
+                    x.pos = 0;
+                    x.len = nr;
+                } else if (nr == 0) {
+                    x.eof = x.flushing = true;
+                } else if (!retry()) {
+                    perror("io61_read");
+                    exit(1);
+                }
+            }
+        }
+    }
+
+    for (auto& x : xfers) {
+        io61_close(x.inf);
+        io61_close(x.outf);
+    }
+}
@@ -10,22 +10,18 @@
 //    input files and "scattered" to many output files.
 //    Default BLOCKSIZE is 1.
 
-ssize_t read_line(io61_file* f, unsigned char* buf, size_t sz, bool lines) {
+// read_block(f, buf, sz, lines, datap)
+//    Reads the next block from `f`, setting `*datap` to point at its data.
+//    If `lines`, the block ends after at most `sz` bytes or the first
+//    newline, and points into `f`'s own buffers; otherwise it is read into
+//    `buf`.
+
+ssize_t read_block(io61_file* f, unsigned char* buf, size_t sz, bool lines,
+                   const unsigned char** datap) {
     if (lines) {
-        size_t i = 0;
-        while (i != sz) {
-            int ch = io61_readc(f);
-            if (ch == EOF) {
-                break;
-            }
-            buf[i] = ch;
-            ++i;
-            if (ch == '\n') {
-                break;
-            }
-        }
-        return i;
+        return io61_readuntil(f, datap, sz, '\n');
     } else {
+        *datap = buf;
         return io61_read(f, buf, sz);
     }
 }
@@ -52,13 +48,15 @@ int main(int argc, char* argv[]) {
     size_t ini = -1, outi = 0;
     while (!infs.empty()) {
         ini = (ini + 1) % infs.size();
-        ssize_t nr = read_line(infs[ini], buf, args.block_size, args.lines);
+        const unsigned char* data;
+        ssize_t nr = read_block(infs[ini], buf, args.block_size, args.lines,
+                                &data);
         if (nr <= 0) {
             io61_close(infs[ini]);
             infs.erase(infs.begin() + ini);
             --ini;
         } else {
-            ssize_t nw = io61_write(outfs[outi], buf, nr);
+            ssize_t nw = io61_write(outfs[outi], data, nr);
             assert(nw == nr);
             outi = (outi + 1) % outfs.size();
         }
@@ -3,6 +3,7 @@
 #include <sys/stat.h>
 #include <climits>
 #include <cerrno>
+#include <mutex>
 
 // slow-io61.cc
 //    This is a copy of the handout version of io61.cc.
@@ -11,12 +12,32 @@
 // io61_file
 //    Data structure for io61 file wrappers.
 
-struct io61_file {
+struct io61_file : io61_fastbuf {
     int fd = -1;     // file descriptor
     int mode;        // open mode (O_RDONLY or O_WRONLY)
+    std::vector<unsigned char> lbuf;    // io61_readuntil result
+    std::mutex m;                       // protects `st`
+    io61_statistics st;                 // io61_stats
 };
 
 
+// io61_count(f, counter, n)
+//    Records a system call on `f`, counted in `counter`, that moved `n`
+//    bytes (or none, if `n <= 0`). Every request in this version is its
+//    own system call, so none are cache hits.
+
+static void io61_count(io61_file* f, unsigned long io61_statistics::* counter,
+                       ssize_t n) {
+    std::unique_lock<std::mutex> lg(f->m);
+    ++(f->st.*counter);
+    ++f->st.nrequests;
+    if (n > 0) {
+        f->st.nrequested += n;
+        f->st.ntransferred += n;
+    }
+}
+
+
 // io61_fdopen(fd, mode)
 //    Returns a new io61_file for file descriptor `fd`. `mode` is either
 //    O_RDONLY for a read-only file or O_WRONLY for a write-only file.
@@ -25,30 +46,65 @@ struct io61_file {
 io61_file* io61_fdopen(int fd, int mode) {
     assert(fd >= 0);
     io61_file* f = new io61_file;
+    // io61.hh's inline io61_readc/io61_writec rely on this
+    assert(static_cast<io61_fastbuf*>(f) == reinterpret_cast<io61_fastbuf*>(f));
     f->fd = fd;
     f->mode = mode;
     return f;
 }
 
 
+// io61_set_buffer_size(sz)
+//    This implementation does not buffer, so there is nothing to size.
+
+void io61_set_buffer_size(size_t) {
+}
+
+
+// io61_set_direct(direct)
+//    This implementation does not support direct I/O.
+
+void io61_set_direct(bool) {
+}
+
+
+// io61_set_mmap(mmap)
+//    This implementation never memory-maps files.
+
+void io61_set_mmap(bool) {
+}
+
+
 // io61_close(f)
 //    Closes the io61_file `f` and releases all its resources.
 
+static void io61_stats_close(io61_file* f);
+
 int io61_close(io61_file* f) {
     io61_flush(f);
     int r = close(f->fd);
+    io61_stats_close(f);
     delete f;
     return r;
 }
 
 
-// io61_readc(f)
+// io61_set_shared(f, shared)
+//    Marks `f` as shared between threads. This implementation never opens
+//    io61_fastbuf windows, so there is nothing to do.
+
+void io61_set_shared(io61_file*, bool) {
+}
+
+
+// io61_readc_slow(f)
 //    Reads a single (unsigned) byte from `f` and returns it. Returns EOF,
 //    which equals -1, on end of file or error.
 
-int io61_readc(io61_file* f) {
+int io61_readc_slow(io61_file* f) {
     unsigned char ch;
     ssize_t nr = read(f->fd, &ch, 1);
+    io61_count(f, &io61_statistics::nreads, nr);
     if (nr == 1) {
         return ch;
     } else if (nr == 0) {
@@ -89,13 +145,56 @@ ssize_t io61_read(io61_file* f, unsigned char* buf, size_t sz) {
 }
 
 
-// io61_writec(f)
+// io61_readuntil(f, bufp, sz, delim)
+//    Reads up to `sz` bytes from `f`, stopping after the first occurrence
+//    of `delim`. Sets `*bufp` to point at the bytes read and returns how
+//    many there are. Returns 0 on end of file and -1 if an error is
+//    encountered before any bytes are read. `sz` must be positive, so that
+//    0 always means end of file; a zero `sz` returns -1 with `errno` set
+//    to `EINVAL`. `*bufp` is valid until the next operation on `f`.
+//
+// io61_getline(f, bufp)
+//    Like `io61_readuntil(f, bufp, SIZE_MAX, '\n')`.
+
+ssize_t io61_readuntil(io61_file* f, const unsigned char** bufp, size_t sz,
+                       int delim) {
+    if (sz == 0) {
+        errno = EINVAL;
+        return -1;
+    }
+    f->lbuf.clear();
+    errno = 0;
+    while (f->lbuf.size() != sz) {
+        int ch = io61_readc(f);
+        if (ch == EOF) {
+            break;
+        }
+        f->lbuf.push_back(ch);
+        if (ch == (unsigned char) delim) {
+            break;
+        }
+    }
+    *bufp = f->lbuf.data();
+    if (!f->lbuf.empty() || errno == 0) {
+        return f->lbuf.size();
+    } else {
+        return -1;
+    }
+}
+
+ssize_t io61_getline(io61_file* f, const unsigned char** bufp) {
+    return io61_readuntil(f, bufp, SIZE_MAX, '\n');
+}
+
+
+// io61_writec_slow(f)
 //    Write a single character `c` to `f` (converted to unsigned char).
 //    Returns 0 on success and -1 on error.
 
-int io61_writec(io61_file* f, int c) {
+int io61_writec_slow(io61_file* f, int c) {
     unsigned char ch = c;
     ssize_t nw = write(f->fd, &ch, 1);
+    io61_count(f, &io61_statistics::nwrites, nw);
     if (nw == 1) {
         return 0;
     } else {
@@ -127,6 +226,72 @@ ssize_t io61_write(io61_file* f, const unsigned char* buf, size_t sz) {
 }
 
 
+// io61_readv(f, iov, iovcnt)
+//    Reads into the `iovcnt` buffers described by `iov`, in order.
+//    Returns the total number of bytes read, 0 on end of file, or -1 if
+//    an error is encountered before any bytes are read.
+
+ssize_t io61_readv(io61_file* f, const struct iovec* iov, int iovcnt) {
+    size_t nread = 0;
+    for (int i = 0; i != iovcnt; ++i) {
+        ssize_t n = io61_read(f, (unsigned char*) iov[i].iov_base,
+                              iov[i].iov_len);
+        if (n == -1) {
+            return nread != 0 ? (ssize_t) nread : -1;
+        }
+        nread += n;
+        if ((size_t) n != iov[i].iov_len) {
+            break;
+        }
+    }
+    return nread;
+}
+
+
+// io61_writev(f, iov, iovcnt)
+//    Writes the `iovcnt` buffers described by `iov` to `f`, in order.
+//    Returns the total number of bytes written, or -1 if no bytes were
+//    written before an error occurred.
+
+ssize_t io61_writev(io61_file* f, const struct iovec* iov, int iovcnt) {
+    size_t nwritten = 0;
+    for (int i = 0; i != iovcnt; ++i) {
+        ssize_t n = io61_write(f, (const unsigned char*) iov[i].iov_base,
+                               iov[i].iov_len);
+        if (n == -1) {
+            return nwritten != 0 ? (ssize_t) nwritten : -1;
+        }
+        nwritten += n;
+        if ((size_t) n != iov[i].iov_len) {
+            break;
+        }
+    }
+    return nwritten;
+}
+
+
+// io61_copy(in, out, sz)
+//    Copies up to `sz` bytes from `in` to `out`. Returns the number of
+//    bytes copied, which is less than `sz` only on end of file or error,
+//    or -1 if an error is encountered before any bytes are copied.
+
+ssize_t io61_copy(io61_file* in, io61_file* out, size_t sz) {
+    size_t ncopied = 0;
+    while (ncopied != sz) {
+        int ch = io61_readc(in);
+        if (ch == EOF || io61_writec(out, ch) == -1) {
+            break;
+        }
+        ++ncopied;
+    }
+    if (ncopied != 0 || sz == 0 || errno == 0) {
+        return ncopied;
+    } else {
+        return -1;
+    }
+}
+
+
 // io61_flush(f)
 //    If `f` was opened write-only, `io61_flush(f)` forces a write of any
 //    cached data written to `f`. Returns 0 on success; returns -1 if an error
@@ -141,12 +306,58 @@ int io61_flush(io61_file* f) {
 }
 
 
+// io61_poll(pfds, n, timeout)
+//    Like poll(2), but for io61 files. This version has no cache, so
+//    it simply polls the file descriptors.
+
+int io61_poll(io61_pollfd* pfds, size_t n, int timeout) {
+    std::vector<struct pollfd> kpfds(n);
+    for (size_t i = 0; i != n; ++i) {
+        kpfds[i] = {pfds[i].f->fd, pfds[i].events, 0};
+    }
+    int r = poll(kpfds.data(), n, timeout);
+    for (size_t i = 0; r >= 0 && i != n; ++i) {
+        pfds[i].revents = kpfds[i].revents;
+    }
+    return r;
+}
+
+
+// io61_stats(f)
+//    Returns I/O counters for `f`, or the totals for all closed files
+//    if `f == nullptr`. Only system calls are counted.
+
+static io61_statistics io61_closed_stats;
+static std::mutex io61_closed_stats_mutex;
+
+io61_statistics io61_stats(io61_file* f) {
+    if (!f) {
+        std::unique_lock<std::mutex> lg(io61_closed_stats_mutex);
+        return io61_closed_stats;
+    }
+    std::unique_lock<std::mutex> lg(f->m);
+    return f->st;
+}
+
+static void io61_stats_close(io61_file* f) {
+    std::unique_lock<std::mutex> lg(io61_closed_stats_mutex);
+    io61_statistics& t = io61_closed_stats;
+    t.nrequested += f->st.nrequested;
+    t.ntransferred += f->st.ntransferred;
+    t.nrequests += f->st.nrequests;
+    t.nreads += f->st.nreads;
+    t.nwrites += f->st.nwrites;
+    t.nseeks += f->st.nseeks;
+}
+
+
 // io61_seek(f, off)
 //    Changes the file pointer for file `f` to `off` bytes into the file.
 //    Returns 0 on success and -1 on failure.
 
 int io61_seek(io61_file* f, off_t off) {
     off_t r = lseek(f->fd, (off_t) off, SEEK_SET);
+    io61_count(f, &io61_statistics::nseeks, 0);
     // Ignore the returned offset unless it’s an error.
     if (r == -1) {
         return -1;
@@ -3,6 +3,7 @@
 #include <sys/stat.h>
 #include <climits>
 #include <cerrno>
+#include <algorithm>
 
 // stdio-io61.cc
 //    This version of io61.cc is a simple wrapper on stdio. Can you beat it?
@@ -11,10 +12,26 @@
 // io61_file
 //    Data structure for io61 file wrappers.
 
-struct io61_file {
+struct io61_file : io61_fastbuf {
     FILE* f;
+    std::vector<unsigned char> lbuf;    // io61_readuntil result
+    bool eagain = false;                // stream error is from `EAGAIN`?
 };
 
+static size_t io61_bufsz_override = 0;     // io61_set_buffer_size
+
+
+// io61_note_error(f)
+//    Records whether `f`'s stream error, if any, came from `EAGAIN` on a
+//    nonblocking file. io61_poll clears only those errors, so that later
+//    reads and writes are not reported as failures.
+
+static void io61_note_error(io61_file* f) {
+    if (ferror(f->f)) {
+        f->eagain = errno == EAGAIN || errno == EWOULDBLOCK;
+    }
+}
+
 
 // io61_fdopen(fd, mode)
 //    Returns a new io61_file for file descriptor `fd`. `mode` is either
@@ -24,28 +41,71 @@ struct io61_file {
 io61_file* io61_fdopen(int fd, int mode) {
     assert(fd >= 0);
     io61_file* f = new io61_file;
+    // io61.hh's inline io61_readc/io61_writec rely on this
+    assert(static_cast<io61_fastbuf*>(f) == reinterpret_cast<io61_fastbuf*>(f));
     f->f = fdopen(fd, mode == O_RDONLY ? "r" : "w");
+    if (f->f && io61_bufsz_override) {
+        setvbuf(f->f, nullptr, _IOFBF, io61_bufsz_override);
+    }
     return f;
 }
 
 
+// io61_set_buffer_size(sz)
+//    Sets the stdio buffer size for files opened afterwards.
+
+void io61_set_buffer_size(size_t sz) {
+    io61_bufsz_override = sz;
+}
+
+
+// io61_set_direct(direct)
+//    This implementation does not support direct I/O.
+
+void io61_set_direct(bool) {
+}
+
+
+// io61_set_mmap(mmap)
+//    This implementation never memory-maps files.
+
+void io61_set_mmap(bool) {
+}
+
+
 // io61_close(f)
 //    Closes the io61_file `f` and releases all its resources.
 
 int io61_close(io61_file* f) {
-    io61_flush(f);
+    while (io61_flush(f) == EOF && errno == EAGAIN) {
+        // nonblocking output: wait until the rest can be written
+        struct pollfd pfd = {fileno(f->f), POLLOUT, 0};
+        poll(&pfd, 1, -1);
+    }
     int r = fclose(f->f);
     delete f;
     return r;
 }
 
 
-// io61_readc(f)
+// io61_set_shared(f, shared)
+//    Marks `f` as shared between threads. This implementation never opens
+//    io61_fastbuf windows, so there is nothing to do.
+
+void io61_set_shared(io61_file*, bool) {
+}
+
+
+// io61_readc_slow(f)
 //    Reads a single (unsigned) byte from `f` and returns it. Returns EOF,
 //    which equals -1, on end of file or error.
 
-int io61_readc(io61_file* f) {
-    return fgetc(f->f);
+int io61_readc_slow(io61_file* f) {
+    int ch = fgetc(f->f);
+    if (ch == EOF) {
+        io61_note_error(f);
+    }
+    return ch;
 }
 
 
@@ -61,6 +121,7 @@ int io61_readc(io61_file* f) {
 
 ssize_t io61_read(io61_file* f, unsigned char* buf, size_t sz) {
     size_t n = fread(buf, 1, sz, f->f);
+    io61_note_error(f);
     if (n != 0 || sz == 0 || !ferror(f->f)) {
         return (ssize_t) n;
     } else {
@@ -69,13 +130,56 @@ ssize_t io61_read(io61_file* f, unsigned char* buf, size_t sz) {
 }
 
 
-// io61_writec(f)
+// io61_readuntil(f, bufp, sz, delim)
+//    Reads up to `sz` bytes from `f`, stopping after the first occurrence
+//    of `delim`. Sets `*bufp` to point at the bytes read and returns how
+//    many there are. Returns 0 on end of file and -1 if an error is
+//    encountered before any bytes are read. `sz` must be positive, so that
+//    0 always means end of file; a zero `sz` returns -1 with `errno` set
+//    to `EINVAL`. `*bufp` is valid until the next operation on `f`.
+//
+// io61_getline(f, bufp)
+//    Like `io61_readuntil(f, bufp, SIZE_MAX, '\n')`.
+
+ssize_t io61_readuntil(io61_file* f, const unsigned char** bufp, size_t sz,
+                       int delim) {
+    if (sz == 0) {
+        errno = EINVAL;
+        return -1;
+    }
+    f->lbuf.clear();
+    while (f->lbuf.size() != sz) {
+        int ch = getc(f->f);
+        if (ch == EOF) {
+            break;
+        }
+        f->lbuf.push_back(ch);
+        if (ch == (unsigned char) delim) {
+            break;
+        }
+    }
+    *bufp = f->lbuf.data();
+    io61_note_error(f);
+    if (!f->lbuf.empty() || !ferror(f->f)) {
+        return (ssize_t) f->lbuf.size();
+    } else {
+        return (ssize_t) -1;
+    }
+}
+
+ssize_t io61_getline(io61_file* f, const unsigned char** bufp) {
+    return io61_readuntil(f, bufp, SIZE_MAX, '\n');
+}
+
+
+// io61_writec_slow(f)
 //    Write a single character `c` to `f` (converted to unsigned char).
 //    Returns 0 on success and -1 on error.
 
-int io61_writec(io61_file* f, int c) {
+int io61_writec_slow(io61_file* f, int c) {
     int r = fputc(c, f->f);
     if (r == EOF) {
+        io61_note_error(f);
         return -1;
     } else {
         return 0;
@@ -92,6 +196,7 @@ int io61_writec(io61_file* f, int c) {
 
 ssize_t io61_write(io61_file* f, const unsigned char* buf, size_t sz) {
     size_t n = fwrite(buf, 1, sz, f->f);
+    io61_note_error(f);
     if (n != 0 || sz == 0 || !ferror(f->f)) {
         return (ssize_t) n;
     } else {
@@ -100,6 +205,78 @@ ssize_t io61_write(io61_file* f, const unsigned char* buf, size_t sz) {
 }
 
 
+// io61_readv(f, iov, iovcnt)
+//    Reads into the `iovcnt` buffers described by `iov`, in order.
+//    Returns the total number of bytes read, 0 on end of file, or -1 if
+//    an error is encountered before any bytes are read.
+
+ssize_t io61_readv(io61_file* f, const struct iovec* iov, int iovcnt) {
+    size_t nread = 0;
+    for (int i = 0; i != iovcnt; ++i) {
+        size_t n = fread(iov[i].iov_base, 1, iov[i].iov_len, f->f);
+        nread += n;
+        if (n != iov[i].iov_len) {
+            break;
+        }
+    }
+    io61_note_error(f);
+    if (nread != 0 || !ferror(f->f)) {
+        return (ssize_t) nread;
+    } else {
+        return (ssize_t) -1;
+    }
+}
+
+
+// io61_writev(f, iov, iovcnt)
+//    Writes the `iovcnt` buffers described by `iov` to `f`, in order.
+//    Returns the total number of bytes written, or -1 if no bytes were
+//    written before an error occurred.
+
+ssize_t io61_writev(io61_file* f, const struct iovec* iov, int iovcnt) {
+    size_t nwritten = 0;
+    for (int i = 0; i != iovcnt; ++i) {
+        size_t n = fwrite(iov[i].iov_base, 1, iov[i].iov_len, f->f);
+        nwritten += n;
+        if (n != iov[i].iov_len) {
+            break;
+        }
+    }
+    io61_note_error(f);
+    if (nwritten != 0 || !ferror(f->f)) {
+        return (ssize_t) nwritten;
+    } else {
+        return (ssize_t) -1;
+    }
+}
+
+
+// io61_copy(in, out, sz)
+//    Copies up to `sz` bytes from `in` to `out`. Returns the number of
+//    bytes copied, which is less than `sz` only on end of file or error,
+//    or -1 if an error is encountered before any bytes are copied.
+
+ssize_t io61_copy(io61_file* in, io61_file* out, size_t sz) {
+    unsigned char buf[BUFSIZ];
+    size_t ncopied = 0;
+    while (ncopied != sz) {
+        size_t nr = fread(buf, 1, std::min(sz - ncopied, sizeof(buf)), in->f);
+        size_t nw = fwrite(buf, 1, nr, out->f);
+        ncopied += nw;
+        if (nr == 0 || nw != nr) {
+            break;
+        }
+    }
+    io61_note_error(in);
+    io61_note_error(out);
+    if (ncopied != 0 || sz == 0 || (!ferror(in->f) && !ferror(out->f))) {
+        return (ssize_t) ncopied;
+    } else {
+        return (ssize_t) -1;
+    }
+}
+
+
 // io61_flush(f)
 //    If `f` was opened write-only, `io61_flush(f)` forces a write of any
 //    cached data written to `f`. Returns 0 on success; returns -1 if an error
@@ -109,7 +286,57 @@ ssize_t io61_write(io61_file* f, const unsigned char* buf, size_t sz) {
 //    drop any data cached for reading.
 
 int io61_flush(io61_file* f) {
-    return fflush(f->f);
+    int r = fflush(f->f);
+    io61_note_error(f);
+    return r;
+}
+
+
+// io61_poll(pfds, n, timeout)
+//    Like poll(2), but for io61 files. Input already buffered by stdio
+//    counts as ready (detected only on glibc); everything else polls the
+//    underlying file descriptors. Stream errors from `EAGAIN` are
+//    cleared so that the next read or write starts afresh; other errors
+//    stay set.
+
+int io61_poll(io61_pollfd* pfds, size_t n, int timeout) {
+    std::vector<struct pollfd> kpfds(n);
+    int nready = 0;
+    for (size_t i = 0; i != n; ++i) {
+        FILE* sf = pfds[i].f->f;
+        if (pfds[i].f->eagain) {
+            clearerr(sf);
+            pfds[i].f->eagain = false;
+        }
+        pfds[i].revents = 0;
+#ifdef __GLIBC__
+        if ((pfds[i].events & POLLIN) && sf->_IO_read_ptr < sf->_IO_read_end) {
+            pfds[i].revents = POLLIN;
+            ++nready;
+        }
+#endif
+        kpfds[i] = {pfds[i].revents ? -1 : fileno(sf), pfds[i].events, 0};
+    }
+    int r = poll(kpfds.data(), n, nready ? 0 : timeout);
+    if (r == -1) {
+        return nready ? nready : -1;
+    }
+    for (size_t i = 0; i != n; ++i) {
+        if (kpfds[i].fd >= 0 && kpfds[i].revents) {
+            pfds[i].revents = kpfds[i].revents;
+            ++nready;
+        }
+    }
+    return nready;
+}
+
+
+// io61_stats(f)
+//    Returns I/O counters for `f`. This version keeps none.
+
+io61_statistics io61_stats(io61_file* f) {
+    (void) f;
+    return io61_statistics();
 }
 
 
@@ -0,0 +1,55 @@
+#include "io61.hh"
+#include <thread>
+
+// Usage: ./tally61 [-j THREADS] [-o OUTFILE] [FILE]
+//    Counts how often each byte value occurs in FILE and writes one
+//    "VALUE COUNT" line per value that occurs to OUTFILE. Several threads
+//    read FILE one character at a time through a single io61 file,
+//    which is marked with io61_set_shared. The counts do not depend on
+//    how the threads interleave, so every byte must be read exactly once.
+
+static void tally_thread(io61_file* inf, size_t* counts) {
+    int ch;
+    while ((ch = io61_readc(inf)) != EOF) {
+        ++counts[ch];
+    }
+}
+
+
+int main(int argc, char* argv[]) {
+    // Parse arguments
+    io61_args args = io61_args("j:o:i:").parse(argc, argv);
+    if (args.nthreads == 0) {
+        args.nthreads = std::max(std::thread::hardware_concurrency(), 1U);
+    }
+
+    // Open files
+    io61_file* inf = io61_open_check(args.input_file, O_RDONLY);
+    io61_set_shared(inf, true);
+    FILE* outf = stdio_open_check(args.output_file,
+                                  O_WRONLY | O_CREAT | O_TRUNC);
+
+    // Count bytes in several threads
+    std::vector<std::vector<size_t>> counts(args.nthreads,
+                                            std::vector<size_t>(256, 0));
+    std::vector<std::thread> threads;
+    for (unsigned i = 0; i != args.nthreads; ++i) {
+        threads.emplace_back(tally_thread, inf, counts[i].data());
+    }
+    for (auto& t : threads) {
+        t.join();
+    }
+    io61_close(inf);
+
+    // Write totals
+    for (int ch = 0; ch != 256; ++ch) {
+        size_t n = 0;
+        for (auto& c : counts) {
+            n += c[ch];
+        }
+        if (n != 0) {
+            fprintf(outf, "%d %zu\n", ch, n);
+        }
+    }
+    fclose(outf);
+}
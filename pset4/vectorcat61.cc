@@ -0,0 +1,51 @@
+#include "io61.hh"
+
+// Usage: ./vectorcat61 [-b MAXFIELDSIZE] [-r RANDOMSEED] [-o OUTFILE] [FILE]
+//    Copies the input FILE to OUTFILE in records of 16 fields. Each
+//    field has a random size between 1 and MAXFIELDSIZE (which defaults
+//    to 64), and each record is transferred with one `io61_readv` and
+//    one `io61_writev`.
+
+int main(int argc, char* argv[]) {
+    // Parse arguments
+    io61_args args = io61_args("b:r:o:i:D:Fy", 64).set_seed(83419).parse(argc, argv);
+
+    // Allocate buffer, open files
+    static constexpr int nfields = 16;
+    unsigned char* buf = new unsigned char[nfields * args.block_size];
+    std::uniform_int_distribution<size_t> szdistrib(1, args.block_size);
+
+    io61_file* inf = io61_open_check(args.input_file, O_RDONLY);
+    io61_file* outf = io61_open_check(args.output_file,
+                                      O_WRONLY | O_CREAT | O_TRUNC);
+    args.after_open(inf, O_RDONLY);
+    args.after_open(outf, O_WRONLY);
+
+    // Copy file data
+    while (true) {
+        struct iovec iov[nfields];
+        for (int i = 0; i != nfields; ++i) {
+            iov[i].iov_base = buf + i * args.block_size;
+            iov[i].iov_len = szdistrib(args.engine);
+        }
+        ssize_t nr = io61_readv(inf, iov, nfields);
+        if (nr <= 0) {
+            break;
+        }
+
+        // Trim the record to the data actually read
+        int n = 0;
+        for (size_t left = nr; left != 0; ++n) {
+            iov[n].iov_len = std::min(iov[n].iov_len, left);
+            left -= iov[n].iov_len;
+        }
+        ssize_t nw = io61_writev(outf, iov, n);
+        assert(nw == nr);
+
+        args.after_write(outf);
+    }
+
+    io61_close(inf);
+    io61_close(outf);
+    delete[] buf;
+}
@@ -416,6 +416,10 @@ sub set_param ($$) {
 }
 
 
+# run_one_check(ftxcmd, diffcmd, [time_limit])
+#    Runs `ftxcmd`, then `diffcmd` to check its output, if defined
+#    (some programs check their own output).
+
 sub run_one_check ($$;$) {
     my ($ftxcmd, $diffcmd, $time_limit) = @_;
     $time_limit = 30 if !$time_limit;
@@ -433,6 +437,7 @@ sub run_one_check ($$;$) {
         print OUT "${Red}FAILURE${Redctx} (", unparse_termination($info), ")${Off}\n";
         return;
     }
+    return if !defined($diffcmd);
 
     $diffcmd =~ s/diff-ftxdb\.pl/diff-ftxdb\.pl --color/ if $color;
     $info = run_sh61($diffcmd, "stdin" => "/dev/null", "stdout" => "pipe", "size_limit" => 100000, "time_limit" => 10);
@@ -495,6 +500,43 @@ if (testid_runnable("FTX5")) {
     run_one_check("./ftxxfer bigaccounts.fdb", "./diff-ftxdb.pl bigaccounts.fdb");
 }
 
+if (testid_runnable("FTX6")) {
+    print OUT "\n${Cyan}Test FTX6: ./ftxaudit -n 20000 check...${Off}\n";
+    run_one_check("./ftxaudit -n 20000", "./diff-ftxdb.pl");
+}
+
+if (testid_runnable("FTX7")) {
+    print OUT "\n${Cyan}Test FTX7: ./ftxdeadlock check...${Off}\n";
+    run_one_check("./ftxdeadlock", "./diff-ftxdb.pl");
+}
+
+if (testid_runnable("FTX8")) {
+    print OUT "\n${Cyan}Test FTX8: ./ftxrocket -O check...${Off}\n";
+    run_one_check("./ftxrocket -O", "./diff-ftxdb.pl");
+}
+
+if (testid_runnable("FTX9")) {
+    print OUT "\n${Cyan}Test FTX9: IO61_NOMAP=1 ./ftxxfer bigaccounts.fdb check...${Off}\n";
+    local $ENV{"IO61_NOMAP"} = 1;
+    run_one_check("./ftxxfer bigaccounts.fdb", "./diff-ftxdb.pl bigaccounts.fdb");
+}
+
+if (testid_runnable("FTX10")) {
+    print OUT "\n${Cyan}Test FTX10: ./ftxgrow check...${Off}\n";
+    run_one_check("./ftxgrow", undef);
+}
+
+if (testid_runnable("FTX11")) {
+    print OUT "\n${Cyan}Test FTX11: ./ftxgrow -s 40008 check...${Off}\n";
+    run_one_check("./ftxgrow -s 40008", undef);
+}
+
+if (testid_runnable("FTX12")) {
+    print OUT "\n${Cyan}Test FTX12: IO61_SPIN=256 ./ftxrocket check...${Off}\n";
+    local $ENV{"IO61_SPIN"} = 256;
+    run_one_check("./ftxrocket", "./diff-ftxdb.pl");
+}
+
 
 set_param("SAN", 1);
 
@@ -513,4 +555,9 @@ if (testid_runnable("SAN3")) {
     run_one_check("./ftxxfer -n 10000 bigaccounts.fdb", "./diff-ftxdb.pl bigaccounts.fdb");
 }
 
+if (testid_runnable("SAN4")) {
+    print OUT "\n${Cyan}Test SAN4: ./ftxgrow -s 40008 check with sanitizers...${Off}\n";
+    run_one_check("./ftxgrow -n 20000 -s 40008", undef);
+}
+
 exit(0);
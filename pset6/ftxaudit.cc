@@ -0,0 +1,114 @@
+#include "ftxdb.hh"
+#include <sys/resource.h>
+#include <atomic>
+#include <thread>
+#include <mutex>
+
+// Usage: ./ftxaudit [-j NTHREADS] [-J NAUDITORS] [-n NOPS] [FILE]
+//    Perform NOPS “bank transfers” in each of NTHREADS - NAUDITORS
+//    threads within FILE, while NAUDITORS threads repeatedly audit the
+//    whole database under a shared lock. Every audit must find the same
+//    total balance. Auditors hold their shared locks at the same time
+//    rather than one after another.
+
+static std::atomic<bool> transfers_done = false;
+
+
+// Return the total balance of all accounts in `db`
+static long total_balance(ftx_db& db) {
+    long total = 0;
+    for (size_t a = 0; a != db.naccounts; ++a) {
+        long bal;
+        int r = ftx_acct(db, a).read(nullptr, 0, &bal);
+        assert(r == 0);
+        total += bal;
+    }
+    return total;
+}
+
+
+static void audit_thread(ftx_db& db, long expected, size_t& auditcount) {
+    size_t i = 0;
+    while (!transfers_done) {
+        // Lock the whole database for reading
+        int r = io61_lock(db.f, 0, db.naccounts * db.asize, LOCK_SH);
+        assert(r == 0);
+
+        long total = total_balance(db);
+
+        // Model network delay or heavy computation
+        usleep(1);
+
+        r = io61_unlock(db.f, 0, db.naccounts * db.asize);
+        assert(r == 0);
+
+        if (total != expected) {
+            fprintf(stderr, "audit failed: total %ld, expected %ld\n",
+                    total, expected);
+            exit(1);
+        }
+        ++i;
+    }
+    auditcount = i;
+}
+
+
+int main(int argc, char* argv[]) {
+    // Parse arguments
+    io61_args args = io61_args("i:D:j:J:n:").set_nthreads(4)
+        .set_noperations(100'000)
+        .set_ndistinguished_threads(3)
+        .parse(argc, argv);
+    if (args.ndistinguished_threads >= args.nthreads) {
+        fprintf(stderr, "%s: need at least one transfer thread\n", argv[0]);
+        exit(1);
+    }
+
+    // Allocate buffer, open files
+    ftx_db* db = ftx_db::open_args(args);
+    args.after_open(db->f, O_RDWR);
+    long expected = total_balance(*db);
+    std::random_device seed_randomness;
+    double start_time = monotonic_timestamp();
+
+    // Run auditors and transfers
+    std::vector<std::thread> th(args.nthreads);
+    std::vector<size_t> opcounts(args.nthreads, 0);
+    for (int i = 0; i != args.nthreads; ++i) {
+        if (i < args.ndistinguished_threads) {
+            th[i] = std::thread(audit_thread, std::ref(*db), expected,
+                                std::ref(opcounts[i]));
+        } else {
+            th[i] = std::thread(ftx_transfer_thread, std::ref(*db),
+                                args.noperations, std::ref(opcounts[i]),
+                                seed_randomness());
+        }
+    }
+
+    size_t totalops = 0, totalaudits = 0;
+    for (int i = args.nthreads - 1; i >= 0; --i) {
+        if (i == args.ndistinguished_threads - 1) {
+            transfers_done = true;
+        }
+        th[i].join();
+        if (i < args.ndistinguished_threads) {
+            totalaudits += opcounts[i];
+        } else {
+            totalops += opcounts[i];
+        }
+    }
+
+    // Flush and close
+    delete db;
+
+    double end_time = monotonic_timestamp();
+    struct rusage usage;
+    int r = getrusage(RUSAGE_SELF, &usage);
+    assert(r == 0);
+    fprintf(stderr, "%d %s, %zu %s, %zu %s, %d.%06ds CPU time, %.6fs real time\n",
+            args.nthreads, args.nthreads == 1 ? "thread" : "threads",
+            totalops, totalops == 1 ? "operation" : "operations",
+            totalaudits, totalaudits == 1 ? "audit" : "audits",
+            (int) usage.ru_utime.tv_sec, (int) usage.ru_utime.tv_usec,
+            end_time - start_time);
+}
@@ -26,11 +26,12 @@ static void transfer_thread(ftx_db& db, size_t nops, size_t& opcount,
             continue;
         }
 
-        // Lock both accounts; prevent deadlock with lock ordering
+        // Lock both accounts at once, which cannot deadlock
         ftx_acct acct1{db, aindex[0]};
         ftx_acct acct2{db, aindex[1]};
-        std::unique_lock guard1{aindex[0] < aindex[1] ? acct1 : acct2};
-        std::unique_lock guard2{aindex[0] < aindex[1] ? acct2 : acct1};
+        ftx_acct::lock_pair(acct1, acct2);
+        std::unique_lock guard1{acct1, std::adopt_lock};
+        std::unique_lock guard2{acct2, std::adopt_lock};
 
         // Read current balances
         char name1[16], name2[16];
@@ -1,6 +1,8 @@
 #ifndef FTXDB_HH
 #define FTXDB_HH
 #include "io61.hh"
+#include <atomic>
+#include <memory>
 #include <mutex>
 #include <random>
 #include <stdexcept>
@@ -18,6 +20,7 @@ struct ftx_db {
     size_t balance_offset = 8; // offset of balance field within record
     size_t balance_size = 7;   // size of balance field within record
     static constexpr size_t max_asize = 512; // maximum asize allowed
+    std::unique_ptr<std::atomic<unsigned long>[]> versions; // per-account write counts
 
     ftx_db(io61_file* f);
     ~ftx_db();
@@ -30,6 +33,7 @@ struct ftx_db {
 
 struct ftx_acct {
     const ftx_db& db;
+    size_t aindex;
     off_t offset;
     bool locked = false;
 
@@ -37,8 +41,10 @@ struct ftx_acct {
 
     inline void lock();
     inline void unlock();
+    static inline void lock_pair(ftx_acct& a, ftx_acct& b);
     inline int read(char* namebuf, size_t namesz, long* balance) const;
     inline int write(long balance) const;
+    inline unsigned long version() const;
 
     static int parse(
         const char* buf, size_t len, const ftx_db& db,
@@ -51,10 +57,11 @@ struct ftx_acct {
 
 
 // Create an account object for account number `aindex`
-inline ftx_acct::ftx_acct(const ftx_db& db_, size_t aindex)
+inline ftx_acct::ftx_acct(const ftx_db& db_, size_t aindex_)
     : db(db_) {
-    assert(aindex < this->db.naccounts);
-    this->offset = aindex * this->db.asize;
+    assert(aindex_ < this->db.naccounts);
+    this->aindex = aindex_;
+    this->offset = aindex_ * this->db.asize;
 }
 
 
@@ -67,6 +74,19 @@ inline void ftx_acct::lock() {
 }
 
 
+// Lock accounts `a` and `b` together, all or nothing; callers need no
+// lock ordering
+inline void ftx_acct::lock_pair(ftx_acct& a, ftx_acct& b) {
+    assert(!a.locked && !b.locked && &a.db == &b.db);
+    io61_range ranges[2] = {
+        {a.offset, off_t(a.db.asize)}, {b.offset, off_t(b.db.asize)}
+    };
+    int r = io61_lock_many(a.db.f, ranges, 2, LOCK_EX);
+    assert(r == 0);
+    a.locked = b.locked = true;
+}
+
+
 // Unlock this account
 inline void ftx_acct::unlock() {
     assert(this->locked);
@@ -106,8 +126,66 @@ inline int ftx_acct::write(long balance) const {
     if (size_t(nw) != len) {
         errno = EINVAL;
         return -1;
-    } else {
-        return 0;
+    }
+
+    // Publish the write to optimistic readers
+    this->db.versions[this->aindex].fetch_add(1, std::memory_order_release);
+    return 0;
+}
+
+
+// Return this account’s version stamp, which changes after every write
+inline unsigned long ftx_acct::version() const {
+    return this->db.versions[this->aindex].load(std::memory_order_acquire);
+}
+
+
+// Perform `nops` random transfers between pairs of accounts in `db`,
+// locking each pair together, and store the number performed in
+// `opcount`. This is the transfer loop shared by ftxxfer and ftxaudit.
+void ftx_transfer_thread(ftx_db& db, size_t nops, size_t& opcount,
+                         unsigned seed);
+
+
+// ftx_txn_stats
+//    Outcomes of optimistic transactions.
+
+struct ftx_txn_stats {
+    size_t ncommits = 0;       // transactions that validated and wrote
+    size_t naborts = 0;        // attempts retried after a conflict
+};
+
+
+// Transfer between `a` and `b` optimistically. Read both balances and
+// version stamps without locking, and call `compute(bal)` to update
+// `bal[0..1]`. Then lock both accounts just long enough to check that
+// neither version changed and write the new balances. On a conflict,
+// including a torn unlocked read, retry from the start.
+template <typename F>
+inline void ftx_optimistic_transfer(ftx_acct& a, ftx_acct& b, F compute,
+                                    ftx_txn_stats& stats) {
+    while (true) {
+        unsigned long version[2] = { a.version(), b.version() };
+        long bal[2];
+        if (a.read(nullptr, 0, &bal[0]) == 0
+            && b.read(nullptr, 0, &bal[1]) == 0) {
+            compute(bal);
+
+            ftx_acct::lock_pair(a, b);
+            bool valid = a.version() == version[0]
+                && b.version() == version[1];
+            if (valid) {
+                a.write(bal[0]);
+                b.write(bal[1]);
+            }
+            a.unlock();
+            b.unlock();
+            if (valid) {
+                ++stats.ncommits;
+                return;
+            }
+        }
+        ++stats.naborts;
     }
 }
 
@@ -0,0 +1,115 @@
+#include "ftxdb.hh"
+#include <sys/resource.h>
+#include <barrier>
+#include <thread>
+#include <mutex>
+
+// Usage: ./ftxdeadlock [-j NTHREADS] [-n NROUNDS] [FILE]
+//    Provoke NROUNDS deadlocks among NTHREADS threads within FILE. In
+//    each round, thread i locks account i, waits until every thread holds
+//    its first lock, and then locks account i+1 (mod NTHREADS), closing a
+//    cycle. io61_lock must fail with EDEADLK in at least one thread per
+//    round; that thread releases its lock and tries again.
+
+static void deadlock_thread(ftx_db& db, int index, int nthreads,
+                            size_t nrounds, std::barrier<>& barrier,
+                            size_t& opcount, size_t& deadlockcount) {
+    ftx_acct acct1{db, size_t(index)};
+    ftx_acct acct2{db, size_t((index + 1) % nthreads)};
+
+    size_t ndeadlocks = 0;
+    for (size_t i = 0; i != nrounds; ++i) {
+        // Lock first account, then wait for every thread to do the same
+        int r = io61_lock(db.f, acct1.offset, db.asize, LOCK_EX);
+        assert(r == 0);
+        barrier.arrive_and_wait();
+
+        // Lock second account; on deadlock, back off and retry
+        while (io61_lock(db.f, acct2.offset, db.asize, LOCK_EX) == -1) {
+            assert(errno == EDEADLK);
+            ++ndeadlocks;
+            r = io61_unlock(db.f, acct1.offset, db.asize);
+            assert(r == 0);
+            r = io61_lock(db.f, acct1.offset, db.asize, LOCK_EX);
+            assert(r == 0);
+        }
+
+        // Transfer one unit from the first account to the second
+        long bal[2];
+        acct1.read(nullptr, 0, &bal[0]);
+        acct2.read(nullptr, 0, &bal[1]);
+        long delta = std::min(bal[0], std::min(1L, 9999999 - bal[1]));
+        acct1.write(bal[0] - delta);
+        acct2.write(bal[1] + delta);
+
+        r = io61_unlock(db.f, acct2.offset, db.asize);
+        assert(r == 0);
+        r = io61_unlock(db.f, acct1.offset, db.asize);
+        assert(r == 0);
+
+        // Finish the round before anyone starts the next
+        barrier.arrive_and_wait();
+    }
+    opcount = nrounds;
+    deadlockcount = ndeadlocks;
+}
+
+
+int main(int argc, char* argv[]) {
+    // Parse arguments
+    io61_args args = io61_args("i:D:j:n:").set_nthreads(4)
+        .set_noperations(1'000)
+        .parse(argc, argv);
+    if (args.nthreads < 2) {
+        fprintf(stderr, "%s: need at least two threads\n", argv[0]);
+        exit(1);
+    }
+
+    // Allocate buffer, open files
+    ftx_db* db = ftx_db::open_args(args);
+    args.after_open(db->f, O_RDWR);
+    if (size_t(args.nthreads) > db->naccounts) {
+        fprintf(stderr, "%s: need at least one account per thread\n", argv[0]);
+        exit(1);
+    }
+    double start_time = monotonic_timestamp();
+
+    // Run deadlocking threads
+    std::barrier barrier(args.nthreads);
+    std::vector<std::thread> th(args.nthreads);
+    std::vector<size_t> opcounts(args.nthreads, 0);
+    std::vector<size_t> deadlockcounts(args.nthreads, 0);
+    for (int i = 0; i != args.nthreads; ++i) {
+        th[i] = std::thread(deadlock_thread, std::ref(*db), i, args.nthreads,
+                            args.noperations, std::ref(barrier),
+                            std::ref(opcounts[i]), std::ref(deadlockcounts[i]));
+    }
+
+    size_t totalops = 0, totaldeadlocks = 0;
+    for (int i = 0; i != args.nthreads; ++i) {
+        th[i].join();
+        totalops += opcounts[i];
+        totaldeadlocks += deadlockcounts[i];
+    }
+
+    // Flush and close
+    delete db;
+
+    double end_time = monotonic_timestamp();
+    struct rusage usage;
+    int r = getrusage(RUSAGE_SELF, &usage);
+    assert(r == 0);
+    fprintf(stderr, "%d %s, %zu %s, %zu %s, %d.%06ds CPU time, %.6fs real time\n",
+            args.nthreads, args.nthreads == 1 ? "thread" : "threads",
+            totalops, totalops == 1 ? "operation" : "operations",
+            totaldeadlocks, totaldeadlocks == 1 ? "deadlock" : "deadlocks",
+            (int) usage.ru_utime.tv_sec, (int) usage.ru_utime.tv_usec,
+            end_time - start_time);
+
+    // Every round must have detected its deadlock
+    if (totaldeadlocks < args.noperations) {
+        fprintf(stderr, "%s: only %zu deadlocks detected in %zu rounds\n",
+                argv[0], totaldeadlocks, args.noperations);
+        exit(1);
+    }
+}
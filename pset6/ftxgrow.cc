@@ -0,0 +1,172 @@
+#include "ftxdb.hh"
+#include <sys/resource.h>
+#include <thread>
+#include <mutex>
+#include <algorithm>
+
+// Usage: ./ftxgrow [-j NTHREADS] [-n NRECORDS] [-s SIZE] [FILE]
+//    Grow FILE (default /tmp/growing.fdb) from SIZE bytes of zeros
+//    (default 0) to NRECORDS 16-byte records using io61_pwrite, with
+//    NTHREADS threads each writing every NTHREADS-th record in random
+//    order. Offsets past SIZE are not mapped, so they go through the
+//    positioned cache, which must zero-fill holes and share the growing
+//    file size between its sets. Between writes, threads read random
+//    records with io61_pread and check that each is either unwritten
+//    (zeros or end of file) or correct. At the end, FILE is reread with
+//    pread(2) and every record checked.
+
+static constexpr size_t rsize = 16;
+static std::atomic<size_t> nerrors = 0;
+
+// Store record `i`'s expected contents in `buf[0..rsize-1]`
+static void make_record(size_t i, char* buf) {
+    char tmp[rsize + 1];
+    snprintf(tmp, sizeof(tmp), "record %08zu\n", i);
+    memcpy(buf, tmp, rsize);
+}
+
+// Check that `buf[0..n-1]`, read from record `i`, is a prefix of
+// either the record or an unwritten record
+static bool check_record(size_t i, const char* buf, size_t n, bool written) {
+    char expected[rsize];
+    make_record(i, expected);
+    if (n != 0 && memcmp(buf, expected, n) == 0) {
+        return true;
+    }
+    return !written && std::all_of(buf, buf + n, [] (char c) { return c == 0; });
+}
+
+static void grow_thread(io61_file* f, int index, int nthreads,
+                        size_t nrecords, size_t& opcount, unsigned seed) {
+    std::mt19937 randomness(seed);
+    std::uniform_int_distribution pick_record(size_t(0), nrecords - 1);
+
+    std::vector<size_t> mine;
+    for (size_t i = index; i < nrecords; i += nthreads) {
+        mine.push_back(i);
+    }
+    std::shuffle(mine.begin(), mine.end(), randomness);
+
+    for (size_t i : mine) {
+        // Write record `i`; a write may stop at the end of the mapping
+        char buf[rsize];
+        make_record(i, buf);
+        off_t off = i * rsize;
+        int r = io61_lock(f, off, rsize, LOCK_EX);
+        assert(r == 0);
+        for (size_t n = 0; n != rsize; ) {
+            ssize_t nw = io61_pwrite(f, buf + n, rsize - n, off + n);
+            assert(nw > 0);
+            n += nw;
+        }
+        r = io61_unlock(f, off, rsize);
+        assert(r == 0);
+
+        // Read some other record, which might not be written yet
+        size_t j = pick_record(randomness);
+        off = j * rsize;
+        r = io61_lock(f, off, rsize, LOCK_SH);
+        assert(r == 0);
+        size_t n = 0;
+        while (n != rsize) {
+            ssize_t nr = io61_pread(f, buf + n, rsize - n, off + n);
+            assert(nr >= 0);
+            if (nr == 0) {
+                break;
+            }
+            n += nr;
+        }
+        r = io61_unlock(f, off, rsize);
+        assert(r == 0);
+        if (!check_record(j, buf, n, false)) {
+            fprintf(stderr, "record %zu: bad contents while growing\n", j);
+            ++nerrors;
+        }
+    }
+    opcount = mine.size();
+}
+
+
+int main(int argc, char* argv[]) {
+    // Parse arguments
+    io61_args args = io61_args("j:n:s:").set_nthreads(4)
+        .set_noperations(200'000)
+        .parse(argc, argv);
+    const char* filename = args.input_file ? args.input_file : "/tmp/growing.fdb";
+    size_t initial_size = args.file_size == SIZE_MAX ? 0 : args.file_size;
+    if (args.noperations == 0 || initial_size > args.noperations * rsize) {
+        fprintf(stderr, "%s: SIZE must not exceed the grown file\n", argv[0]);
+        exit(1);
+    }
+
+    // Create the file at its initial size, then open it for positioned I/O
+    int fd = open(filename, O_RDWR | O_CREAT | O_TRUNC, 0666);
+    if (fd < 0 || ftruncate(fd, initial_size) != 0) {
+        perror(filename);
+        exit(1);
+    }
+    io61_file* f = io61_fdopen(fd, O_RDWR);
+    std::random_device seed_randomness;
+    double start_time = monotonic_timestamp();
+
+    // Run writers
+    std::vector<std::thread> th(args.nthreads);
+    std::vector<size_t> opcounts(args.nthreads, 0);
+    for (int i = 0; i != args.nthreads; ++i) {
+        th[i] = std::thread(grow_thread, f, i, args.nthreads,
+                            args.noperations, std::ref(opcounts[i]),
+                            seed_randomness());
+    }
+
+    size_t totalops = 0;
+    for (int i = 0; i != args.nthreads; ++i) {
+        th[i].join();
+        totalops += opcounts[i];
+    }
+
+    // Flush and close
+    io61_close(f);
+
+    double end_time = monotonic_timestamp();
+    struct rusage usage;
+    int r = getrusage(RUSAGE_SELF, &usage);
+    assert(r == 0);
+    fprintf(stderr, "%d %s, %zu %s, %d.%06ds CPU time, %.6fs real time\n",
+            args.nthreads, args.nthreads == 1 ? "thread" : "threads",
+            totalops, totalops == 1 ? "operation" : "operations",
+            (int) usage.ru_utime.tv_sec, (int) usage.ru_utime.tv_usec,
+            end_time - start_time);
+
+    // Check every record, bypassing io61
+    fd = open(filename, O_RDONLY);
+    assert(fd >= 0);
+    std::vector<char> data(args.noperations * rsize + 1);
+    size_t n = 0;
+    while (true) {
+        ssize_t nr = read(fd, data.data() + n, data.size() - n);
+        assert(nr >= 0);
+        if (nr == 0) {
+            break;
+        }
+        n += nr;
+    }
+    close(fd);
+    if (n != args.noperations * rsize) {
+        fprintf(stderr, "%s: size %zu, expected %zu\n", filename, n,
+                args.noperations * rsize);
+        ++nerrors;
+    }
+    for (size_t i = 0; i * rsize < n; ++i) {
+        size_t len = std::min(rsize, n - i * rsize);
+        if (!check_record(i, &data[i * rsize], len, true)) {
+            fprintf(stderr, "%s: record %zu is wrong\n", filename, i);
+            if (++nerrors > 10) {
+                break;
+            }
+        }
+    }
+    if (nerrors != 0) {
+        exit(1);
+    }
+    fprintf(stderr, "%s OK\n", filename);
+}
@@ -7,6 +7,7 @@ ftx_db::ftx_db(io61_file* f_) {
     size_t sz = io61_filesize(this->f);
     assert(sz % this->asize == 0);
     this->naccounts = sz / this->asize;
+    this->versions.reset(new std::atomic<unsigned long>[this->naccounts]());
 
     // ensure data is cached
     ftx_acct acct(*this, 0);
@@ -107,3 +108,51 @@ std::pair<const char*, size_t> ftx_acct::unparse(char* buf, size_t len,
     *tcr.ptr++ = '\n';
     return std::make_pair(tcr.ptr - db.balance_size - 1, db.balance_size + 1);
 }
+
+
+void ftx_transfer_thread(ftx_db& db, size_t nops, size_t& opcount,
+                         unsigned seed) {
+    // Obtain a source of random account numbers
+    std::mt19937 randomness(seed);
+    std::uniform_int_distribution pick_account(size_t(0), db.naccounts - 1);
+    std::normal_distribution pick_amount(100.0, 10.0);
+
+    size_t i = 0;
+    while (i != nops) {
+        // Pick two random accounts for transfer
+        size_t aindex[2] = {
+            pick_account(randomness), pick_account(randomness)
+        };
+        if (aindex[0] == aindex[1]) {
+            continue;
+        }
+
+        // Lock both accounts at once, which cannot deadlock
+        ftx_acct acct1{db, aindex[0]};
+        ftx_acct acct2{db, aindex[1]};
+        ftx_acct::lock_pair(acct1, acct2);
+        std::unique_lock guard1{acct1, std::adopt_lock};
+        std::unique_lock guard2{acct2, std::adopt_lock};
+
+        // Read current balances
+        long bal[2];
+        acct1.read(nullptr, 0, &bal[0]);
+        acct2.read(nullptr, 0, &bal[1]);
+
+        // Model network delay or heavy computation
+        usleep(1);
+
+        // Compute amount to transfer
+        long delta = std::min(bal[0], (long) pick_amount(randomness));
+        delta = std::min(delta, 9999999 - bal[1]);
+        bal[0] -= delta;
+        bal[1] += delta;
+
+        // Update balances
+        acct1.write(bal[0]);
+        acct2.write(bal[1]);
+
+        ++i;
+    }
+    opcount = i;
+}
@@ -3,12 +3,13 @@
 #include <thread>
 #include <mutex>
 
-// Usage: ./ftxrocket [-j NTHREADS] [-n NOPS] [FILE]
+// Usage: ./ftxrocket [-j NTHREADS] [-n NOPS] [-O] [FILE]
 //    Perform NOPS * NTHREADS “bank transfers” within FILE, completely
-//    legally.
+//    legally. With `-O`, use optimistic transactions.
 
 static void transfer_thread(ftx_db& db, size_t nops, size_t& opcount,
-                            unsigned seed) {
+                            unsigned seed, bool optimistic,
+                            ftx_txn_stats& stats) {
     // Obtain a source of random account numbers
     std::default_random_engine randomness(seed);
     std::uniform_int_distribution pick_account(size_t(0), db.naccounts - 1);
@@ -24,29 +25,41 @@ static void transfer_thread(ftx_db& db, size_t nops, size_t& opcount,
             continue;
         }
 
-        // Lock both accounts; prevent deadlock with lock ordering
         ftx_acct acct1{db, aindex[0]};
         ftx_acct acct2{db, aindex[1]};
-        std::unique_lock guard1{aindex[0] < aindex[1] ? acct1 : acct2};
-        std::unique_lock guard2{aindex[0] < aindex[1] ? acct2 : acct1};
 
-        // Read current balances
-        long bal[2];
-        acct1.read(nullptr, 0, &bal[0]);
-        acct2.read(nullptr, 0, &bal[1]);
+        // Compute new balances from current ones
+        auto transfer = [&] (long bal[2]) {
+            // Model network delay or heavy computation
+            usleep(1);
 
-        // Model network delay or heavy computation
-        usleep(1);
+            // Compute amount to transfer
+            long delta = std::min(bal[0], (long) pick_amount(randomness));
+            delta = std::min(delta, 9999999 - bal[1]);
+            bal[0] -= delta;
+            bal[1] += delta;
+        };
+
+        if (optimistic) {
+            // Read without locks; lock only to validate and commit
+            ftx_optimistic_transfer(acct1, acct2, transfer, stats);
+        } else {
+            // Lock both accounts at once, which cannot deadlock
+            ftx_acct::lock_pair(acct1, acct2);
+            std::unique_lock guard1{acct1, std::adopt_lock};
+            std::unique_lock guard2{acct2, std::adopt_lock};
 
-        // Compute amount to transfer
-        long delta = std::min(bal[0], (long) pick_amount(randomness));
-        delta = std::min(delta, 9999999 - bal[1]);
-        bal[0] -= delta;
-        bal[1] += delta;
+            // Read current balances
+            long bal[2];
+            acct1.read(nullptr, 0, &bal[0]);
+            acct2.read(nullptr, 0, &bal[1]);
 
-        // Update balances
-        acct1.write(bal[0]);
-        acct2.write(bal[1]);
+            transfer(bal);
+
+            // Update balances
+            acct1.write(bal[0]);
+            acct2.write(bal[1]);
+        }
 
         ++i;
     }
@@ -55,7 +68,8 @@ static void transfer_thread(ftx_db& db, size_t nops, size_t& opcount,
 
 
 static void sbf_transfer_thread(ftx_db& db, size_t nops, size_t& opcount,
-                                unsigned seed) {
+                                unsigned seed, bool optimistic,
+                                ftx_txn_stats& stats) {
     // Obtain a source of random account numbers
     std::default_random_engine randomness(seed);
     std::uniform_int_distribution pick_sbf_account(size_t(0), size_t(2));
@@ -81,29 +95,41 @@ static void sbf_transfer_thread(ftx_db& db, size_t nops, size_t& opcount,
             aindex[1] = pick_sbf_account(randomness);
         }
 
-        // Lock both accounts; prevent deadlock with lock ordering
         ftx_acct acct1{db, aindex[0]};
         ftx_acct acct2{db, aindex[1]};
-        std::unique_lock guard1{aindex[0] < aindex[1] ? acct1 : acct2};
-        std::unique_lock guard2{aindex[0] < aindex[1] ? acct2 : acct1};
 
-        // Read current balances
-        long bal[2];
-        acct1.read(nullptr, 0, &bal[0]);
-        acct2.read(nullptr, 0, &bal[1]);
+        // Compute new balances from current ones
+        auto transfer = [&] (long bal[2]) {
+            // Model network delay or heavy computation
+            usleep(1);
 
-        // Model network delay or heavy computation
-        usleep(1);
+            // Compute amount to transfer
+            long delta = std::min(bal[0], (long) pick_amount(randomness));
+            delta = std::min(delta, 9999999 - bal[1]);
+            bal[0] -= delta;
+            bal[1] += delta;
+        };
 
-        // Compute amount to transfer
-        long delta = std::min(bal[0], (long) pick_amount(randomness));
-        delta = std::min(delta, 9999999 - bal[1]);
-        bal[0] -= delta;
-        bal[1] += delta;
+        if (optimistic) {
+            // Read without locks; lock only to validate and commit
+            ftx_optimistic_transfer(acct1, acct2, transfer, stats);
+        } else {
+            // Lock both accounts at once, which cannot deadlock
+            ftx_acct::lock_pair(acct1, acct2);
+            std::unique_lock guard1{acct1, std::adopt_lock};
+            std::unique_lock guard2{acct2, std::adopt_lock};
+
+            // Read current balances
+            long bal[2];
+            acct1.read(nullptr, 0, &bal[0]);
+            acct2.read(nullptr, 0, &bal[1]);
 
-        // Update balances
-        acct1.write(bal[0]);
-        acct2.write(bal[1]);
+            transfer(bal);
+
+            // Update balances
+            acct1.write(bal[0]);
+            acct2.write(bal[1]);
+        }
 
         ++i;
     }
@@ -113,7 +139,7 @@ static void sbf_transfer_thread(ftx_db& db, size_t nops, size_t& opcount,
 
 int main(int argc, char* argv[]) {
     // Parse arguments
-    io61_args args = io61_args("i:D:j:J:n:").set_nthreads(4)
+    io61_args args = io61_args("i:D:j:J:n:O").set_nthreads(4)
         .set_noperations(100'000)
         .set_ndistinguished_threads(1)
         .parse(argc, argv);
@@ -127,22 +153,26 @@ int main(int argc, char* argv[]) {
     // Run transfers
     std::vector<std::thread> th(args.nthreads);
     std::vector<size_t> opcounts(args.nthreads, 0);
+    std::vector<ftx_txn_stats> stats(args.nthreads);
     for (int i = 0; i != args.nthreads; ++i) {
         if (i < args.ndistinguished_threads) {
             th[i] = std::thread(sbf_transfer_thread, std::ref(*db),
                                 args.noperations, std::ref(opcounts[i]),
-                                seed_randomness());
+                                seed_randomness(), args.optimistic,
+                                std::ref(stats[i]));
         } else {
             th[i] = std::thread(transfer_thread, std::ref(*db),
                                 args.noperations, std::ref(opcounts[i]),
-                                seed_randomness());
+                                seed_randomness(), args.optimistic,
+                                std::ref(stats[i]));
         }
     }
 
-    size_t totalops = 0;
+    size_t totalops = 0, totalaborts = 0;
     for (int i = 0; i != args.nthreads; ++i) {
         th[i].join();
         totalops += opcounts[i];
+        totalaborts += stats[i].naborts;
     }
 
     // Flush and close
@@ -152,9 +182,16 @@ int main(int argc, char* argv[]) {
     struct rusage usage;
     int r = getrusage(RUSAGE_SELF, &usage);
     assert(r == 0);
-    fprintf(stderr, "%d %s, %zu %s, %d.%06ds CPU time, %.6fs real time\n",
+    char abortbuf[100] = "";
+    if (args.optimistic) {
+        snprintf(abortbuf, sizeof(abortbuf), "%zu %s (%.2f%%), ",
+                 totalaborts, totalaborts == 1 ? "abort" : "aborts",
+                 totalops ? 100.0 * totalaborts / (totalops + totalaborts) : 0.0);
+    }
+    fprintf(stderr, "%d %s, %zu %s, %s%d.%06ds CPU time, %.6fs real time\n",
             args.nthreads, args.nthreads == 1 ? "thread" : "threads",
             totalops, totalops == 1 ? "operation" : "operations",
+            abortbuf,
             (int) usage.ru_utime.tv_sec, (int) usage.ru_utime.tv_usec,
             end_time - start_time);
 }
@@ -6,52 +6,6 @@
 // Usage: ./ftxxfer [-j NTHREADS] [-n NOPS] [FILE]
 //    Perform NOPS * NTHREADS “bank transfers” within FILE.
 
-static void transfer_thread(ftx_db& db, size_t nops, size_t& opcount,
-                            unsigned seed) {
-    // Obtain a source of random account numbers
-    std::mt19937 randomness(seed);
-    std::uniform_int_distribution pick_account(size_t(0), db.naccounts - 1);
-    std::normal_distribution pick_amount(100.0, 10.0);
-
-    size_t i = 0;
-    while (i != nops) {
-        // Pick two random accounts for transfer
-        size_t aindex[2] = {
-            pick_account(randomness), pick_account(randomness)
-        };
-        if (aindex[0] == aindex[1]) {
-            continue;
-        }
-
-        // Lock both accounts; prevent deadlock with lock ordering
-        ftx_acct acct1{db, aindex[0]};
-        ftx_acct acct2{db, aindex[1]};
-        std::unique_lock guard1{aindex[0] < aindex[1] ? acct1 : acct2};
-        std::unique_lock guard2{aindex[0] < aindex[1] ? acct2 : acct1};
-
-        // Read current balances
-        long bal[2];
-        acct1.read(nullptr, 0, &bal[0]);
-        acct2.read(nullptr, 0, &bal[1]);
-
-        // Model network delay or heavy computation
-        usleep(1);
-
-        // Compute amount to transfer
-        long delta = std::min(bal[0], (long) pick_amount(randomness));
-        delta = std::min(delta, 9999999 - bal[1]);
-        bal[0] -= delta;
-        bal[1] += delta;
-
-        // Update balances
-        acct1.write(bal[0]);
-        acct2.write(bal[1]);
-
-        ++i;
-    }
-    opcount = i;
-}
-
 
 int main(int argc, char* argv[]) {
     // Parse arguments
@@ -69,7 +23,7 @@ int main(int argc, char* argv[]) {
     std::vector<std::thread> th(args.nthreads);
     std::vector<size_t> opcounts(args.nthreads, 0);
     for (int i = 0; i != args.nthreads; ++i) {
-        th[i] = std::thread(transfer_thread, std::ref(*db),
+        th[i] = std::thread(ftx_transfer_thread, std::ref(*db),
                             args.noperations, std::ref(opcounts[i]),
                             seed_randomness());
     }
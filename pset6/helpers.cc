@@ -159,6 +159,9 @@ io61_args& io61_args::parse(int argc, char** argv) {
         case 'M':
             this->modify = true;
             break;
+        case 'O':
+            this->optimistic = true;
+            break;
         case 'r': {
             unsigned long n = strtoul(optarg, &endptr, 0);
             if (endptr == optarg || *endptr) {
@@ -319,6 +322,9 @@ void io61_args::usage() {
     if (strchr(this->opts, 'M')) {
         fprintf(stderr, "    -M            Modify input file in place\n");
     }
+    if (strchr(this->opts, 'O')) {
+        fprintf(stderr, "    -O            Use optimistic transactions\n");
+    }
 }
 
 void io61_args::after_open() {
@@ -400,7 +406,9 @@ io61_profiler::io61_profiler() {
 
 io61_profiler::~io61_profiler() {
     // Measure elapsed real, user, and system times, and report the result
-    // as JSON to file descriptor 100 if it’s available.
+    // as JSON to file descriptor 100 if it’s available. If the `IO61_STATS`
+    // environment variable is set, also report the io61_lock_stats totals
+    // for all closed files.
 
     double real_elapsed = monotonic_timestamp() - this->begin_at;
 
@@ -421,11 +429,19 @@ io61_profiler::~io61_profiler() {
 
     char buf[1000];
     ssize_t len = snprintf(buf, sizeof(buf),
-        "{\"time\":%.6f, \"utime\":%ld.%06ld, \"stime\":%ld.%06ld, \"maxrss\":%ld}\n",
+        "{\"time\":%.6f, \"utime\":%ld.%06ld, \"stime\":%ld.%06ld, \"maxrss\":%ld",
         real_elapsed,
         usage.ru_utime.tv_sec, (long) usage.ru_utime.tv_usec,
         usage.ru_stime.tv_sec, (long) usage.ru_stime.tv_usec,
         maxrss);
+    if (getenv("IO61_STATS")) {
+        io61_lock_statistics st = io61_lock_stats(nullptr);
+        len += snprintf(buf + len, sizeof(buf) - len,
+            ", \"locks\":{\"contended\":%lu, \"spins\":%lu, "
+            "\"parks\":%lu, \"deadlocks\":%lu}",
+            st.ncontended, st.nspins, st.nparks, st.ndeadlocks);
+    }
+    len += snprintf(buf + len, sizeof(buf) - len, "}\n");
 
     off_t off = lseek(100, 0, SEEK_CUR);
     int fd = (off != (off_t) -1 || errno == ESPIPE ? 100 : STDERR_FILENO);
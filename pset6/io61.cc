@@ -8,7 +8,12 @@
 #include <sys/stat.h>
 #include <iostream>
 #include <map>
+#include <functional>
+#include <memory>
 #include <thread>
+#include <algorithm>
+#include <unordered_map>
+#include <vector>
 #include <sys/mman.h> 
 #include <fcntl.h>
 
@@ -16,6 +21,241 @@
 //    YOUR CODE HERE!
 
 
+// io61_range_lock
+//    A lock held by thread `owner` on offsets `[start, end)`.
+
+struct io61_range_lock {
+    off_t start;
+    off_t end;
+    std::thread::id owner;
+    int locktype;                               // LOCK_SH or LOCK_EX
+    unsigned long ticket;                       // arrival order (blocked requests)
+    struct io61_waiter* waiter;                 // wakes the blocked requester
+    double acquired_at;                         // grant time (when profiling)
+
+    // treap links
+    unsigned prio;                              // heap priority
+    off_t max_end;                              // largest `end` in this subtree
+    io61_range_lock* left = nullptr;
+    io61_range_lock* right = nullptr;
+};
+
+
+// io61_lock_tree
+//    Interval tree of held range locks: a treap ordered by `start`, where
+//    each node also records the largest `end` in its subtree. Overlap
+//    queries skip subtrees that end before the query begins, so lookups,
+//    inserts, and erases take O(log n) expected time in the number of held
+//    locks, independent of file size and range length.
+
+struct io61_lock_tree {
+    io61_range_lock* root = nullptr;
+    io61_range_lock* free_list = nullptr;       // released nodes, linked by `right`
+    std::minstd_rand prio_gen;
+
+    ~io61_lock_tree() {
+        destroy(root);
+        destroy(free_list);
+    }
+
+    // Return an unused node, reusing a released one if possible.
+    io61_range_lock* alloc() {
+        if (io61_range_lock* n = free_list) {
+            free_list = n->right;
+            return n;
+        }
+        return new io61_range_lock;
+    }
+
+    // Return `n`, which is not in the tree, to the free list.
+    void release(io61_range_lock* n) {
+        n->left = nullptr;
+        n->right = free_list;
+        free_list = n;
+    }
+
+    // Add `n` to the tree.
+    void insert(io61_range_lock* n) {
+        n->prio = prio_gen();
+        n->left = n->right = nullptr;
+        n->max_end = n->end;
+        auto [l, r] = split(root, n);
+        root = merge(merge(l, n), r);
+    }
+
+    // Remove `n`, which must be in the tree, without freeing it.
+    void erase(io61_range_lock* n) {
+        root = erase(root, n);
+    }
+
+    // Return a held lock that overlaps `[start, end)` and satisfies
+    // `pred`, or nullptr if there is none.
+    template <typename P>
+    io61_range_lock* find(off_t start, off_t end, P pred) const {
+        return find(root, start, end, pred);
+    }
+
+    // Call `fn` on every node that overlaps `[start, end)`.
+    template <typename F>
+    void for_each(off_t start, off_t end, F fn) const {
+        find(start, end, [&] (io61_range_lock* x) {
+            fn(x);
+            return false;
+        });
+    }
+
+private:
+    static bool before(const io61_range_lock* a, const io61_range_lock* b) {
+        return a->start < b->start
+            || (a->start == b->start && std::less<>()(a, b));
+    }
+
+    static io61_range_lock* fix(io61_range_lock* t) {
+        t->max_end = t->end;
+        if (t->left) t->max_end = std::max(t->max_end, t->left->max_end);
+        if (t->right) t->max_end = std::max(t->max_end, t->right->max_end);
+        return t;
+    }
+
+    // Split `t` into nodes ordered before `key` and the rest.
+    static std::pair<io61_range_lock*, io61_range_lock*>
+    split(io61_range_lock* t, const io61_range_lock* key) {
+        if (!t) return {nullptr, nullptr};
+        if (before(t, key)) {
+            auto [l, r] = split(t->right, key);
+            t->right = l;
+            return {fix(t), r};
+        } else {
+            auto [l, r] = split(t->left, key);
+            t->left = r;
+            return {l, fix(t)};
+        }
+    }
+
+    static io61_range_lock* merge(io61_range_lock* l, io61_range_lock* r) {
+        if (!l || !r) return l ? l : r;
+        if (l->prio > r->prio) {
+            l->right = merge(l->right, r);
+            return fix(l);
+        } else {
+            r->left = merge(l, r->left);
+            return fix(r);
+        }
+    }
+
+    static io61_range_lock* erase(io61_range_lock* t, io61_range_lock* n) {
+        assert(t);
+        if (t == n) return merge(t->left, t->right);
+        if (before(n, t)) t->left = erase(t->left, n);
+        else t->right = erase(t->right, n);
+        return fix(t);
+    }
+
+    template <typename P>
+    static io61_range_lock* find(io61_range_lock* t, off_t start, off_t end,
+                                 P& pred) {
+        if (!t || t->max_end <= start) return nullptr;
+        if (auto x = find(t->left, start, end, pred)) return x;
+        if (t->start >= end) return nullptr;
+        if (t->end > start && pred(t)) return t;
+        return find(t->right, start, end, pred);
+    }
+
+    static void destroy(io61_range_lock* t) {
+        if (t) {
+            destroy(t->left);
+            destroy(t->right);
+            delete t;
+        }
+    }
+};
+
+
+// io61_waiter
+//    A blocked lock request. An unlock that might unblock it sets
+//    `signaled`, and notifies `cv` if the requester has parked; the
+//    requester then rechecks its range. `waits_for` lists the threads
+//    holding locks that conflict with the request: its edges in the
+//    waits-for graph.
+
+struct io61_waiter {
+    std::mutex m;
+    std::condition_variable cv;
+    std::atomic<bool> signaled = false;
+    std::atomic<bool> parked = false;           // sleeping (or about to) on `cv`
+    std::vector<std::thread::id> waits_for;     // protected by `deadlock_mutex`
+    bool holder_blocked = false;                // is a `waits_for` thread blocked?
+
+    void signal() {
+        // a spinning requester sees `signaled` without a wakeup; if it
+        // parks first, it sees either `signaled` or the notification
+        signaled = true;
+        if (parked) {
+            std::unique_lock<std::mutex> lg(m);
+            cv.notify_one();
+        }
+    }
+};
+
+
+// io61_lock_profile
+//    Contention counters for one locked range `[start, end)`, kept when
+//    the `IO61_LOCKPROF` environment variable is set. Times are in
+//    seconds.
+
+struct io61_lock_profile {
+    unsigned long nacquired = 0;                // locks granted
+    unsigned long ncontended = 0;               // of those, how many waited
+    unsigned long ntryfail = 0;                 // failed io61_try_lock calls
+    double wait = 0;                            // total wait before grant
+    double max_wait = 0;
+    double hold = 0;                            // total time held
+    double max_hold = 0;
+};
+
+
+// io61_lock_shard
+//    Range lock state for one region of a file. A lock or blocked request
+//    is recorded in every shard its range touches, so requests on
+//    different regions use different mutexes.
+
+struct io61_lock_shard {
+    std::mutex m;
+    io61_lock_tree locks;                       // held range locks
+    io61_lock_tree waiting;                     // blocked lock requests
+    std::map<std::pair<off_t, off_t>, io61_lock_profile> profile; // ranges starting here
+};
+
+
+// io61_pslot, io61_pset
+//    The positioned cache is set-associative. Each aligned 8192-byte block
+//    maps to one set by block number, and may occupy any of that set's
+//    slots; the least recently used slot is replaced. Each set has its
+//    own mutex and each slot its own dirty bit, so positioned I/O on
+//    blocks in different sets proceeds in parallel and a miss flushes at
+//    most one slot. The cache serves every offset the shared mapping does
+//    not cover: offsets past the size at open, and whole files that are
+//    not mapped (unmappable, or `IO61_NOMAP` is set). Those reads and
+//    writes hit memory too, and only misses and flushes make system
+//    calls.
+
+struct io61_pslot {
+    static constexpr off_t bufsz = 8192;
+    off_t tag = -1;                             // offset of first byte in `buf` (-1 if empty)
+    off_t end_tag = -1;                         // offset one past last valid byte
+    bool dirty = false;                         // has slot been written?
+    unsigned long used = 0;                     // set clock at last use
+    std::unique_ptr<unsigned char[]> buf;       // allocated on first fill
+};
+
+struct io61_pset {
+    static constexpr size_t nways = 4;
+    std::mutex m;
+    unsigned long clock = 0;                    // advances on every access
+    io61_pslot slots[nways];
+};
+
+
 // io61_file
 //    Data structure for io61 file wrappers.
 
@@ -36,19 +276,36 @@ struct io61_file {
     char* map = nullptr;                        // memory-mapped IO
     bool is_seq = true;                         // if access pattern is sequential
 
-    // Positioned mode
     std::atomic<bool> dirty = false;            // has cache been written?
-    bool positioned = false;                    // is cache in positioned mode?
+
+    // Positioned mode
+    unsigned char* pmap = nullptr;              // shared read/write mapping (O_RDWR files)
+    off_t pmap_size = 0;                        // bytes covered by `pmap`
+    bool durable = false;                       // msync `pmap` on flush (O_SYNC/O_DSYNC)?
+    static constexpr size_t npsets = 64;
+    std::unique_ptr<io61_pset[]> psets;         // positioned cache (O_RDWR files)
+    std::atomic<off_t> psize = 0;               // file size, including cached writes
 
     // Synchronisation
-    static const size_t nchunks = 1 << 18;      // number of chunks the file is divided into
-    off_t chunk_sz;                             // how big is each lockable block?
-    std::mutex m;                               // for accessing array containing locked regions
-    std::condition_variable_any cv;             // for blocking
-    int nlocked[nchunks];                       // number of times each chunk is locked
-    std::thread::id owner[nchunks];             // pid of the process that owns the lock
+    std::mutex m;                               // for accessing the single-slot cache
+    static constexpr size_t nshards = 32;
+    io61_lock_shard shards[nshards];            // range lock state, by file region
+    off_t shard_span;                           // bytes of file per shard
+    std::atomic<unsigned long> next_ticket = 0; // ticket for next blocked request
+    std::atomic<unsigned> spin_limit;           // pause budget for spinning waiters
+
+    // Lock statistics (io61_lock_stats)
+    std::atomic<unsigned long> ncontended = 0;
+    std::atomic<unsigned long> nspins = 0;
+    std::atomic<unsigned long> nparks = 0;
+    std::atomic<unsigned long> ndeadlocks = 0;
+    size_t lockprof = 0;                        // ranges in profile report; 0 = off
 };
 
+// bounds on `spin_limit`, in pause instructions
+static constexpr unsigned io61_spin_min = 64;
+static constexpr unsigned io61_spin_max = 8192;
+
 void io61_check_assertions(io61_file* f)
 {
     assert(f->tag <= f->pos_tag && f->pos_tag <= f->end_tag);
@@ -77,14 +334,54 @@ io61_file* io61_fdopen(int fd, int mode) {
         f->tag = f->pos_tag = f->end_tag = 0;
     }
     f->size = io61_filesize(f); 
-    f->dirty = f->positioned = false;
+    f->dirty = false;
+
+    // divide the file into lock shards; offsets past the end belong to
+    // the last shard
+    f->shard_span = std::max((off_t) io61_filesize(f) / (off_t) f->nshards, (off_t) 64); 
+
+    // spinning only helps if a lock holder can run at the same time.
+    // `IO61_SPIN=N` overrides that, starting the budget at N pauses
+    // (clamped to the usual bounds) even on one CPU; `IO61_SPIN=0`
+    // turns spinning off
+    static const unsigned ncpus = std::thread::hardware_concurrency();
+    f->spin_limit = ncpus > 1 ? io61_spin_min * 4 : 0;
+    if (const char* sp = getenv("IO61_SPIN"))
+    {
+        unsigned long n = strtoul(sp, nullptr, 10);
+        f->spin_limit = n == 0 ? 0 : std::clamp<unsigned long>(n, io61_spin_min, io61_spin_max);
+    }
 
-    // calculate chunk size
-    f->chunk_sz = (off_t) (io61_filesize(f) / f->nchunks); 
-    if (f->chunk_sz < 16) f->chunk_sz = 16;
+    // `IO61_LOCKPROF=N` profiles range locks, reporting the N most
+    // contended ranges on close
+    if (const char* lp = getenv("IO61_LOCKPROF"))
+    {
+        f->lockprof = strtoul(lp, nullptr, 10);
+        if (f->lockprof == 0) f->lockprof = 10;
+    }
 
-    // initialise nlocked to 0 since initially nothing is locked
-    for (int i = 0; i < (int) f->nchunks; i++) f->nlocked[i] = 0; 
+
+    // read/write files get a positioned cache, and regular ones get a
+    // shared read/write mapping for io61_pread and io61_pwrite; it is
+    // created once here so its users never need a mutex. `IO61_NOMAP`
+    // leaves the mapping out, so the positioned cache serves everything
+    if (f->mode == O_RDWR) 
+    {
+        f->psets.reset(new io61_pset[f->npsets]); 
+        f->psize = std::max(io61_filesize(f), (off_t) 0); 
+    }
+    if (f->mode == O_RDWR && f->seekable && (off_t) f->size > 0
+        && !getenv("IO61_NOMAP"))
+    {
+        void* map = mmap(nullptr, f->size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0); 
+        if (map != MAP_FAILED)
+        {
+            f->pmap = (unsigned char*) map; 
+            f->pmap_size = f->size; 
+            int fl = fcntl(fd, F_GETFL); 
+            f->durable = fl != -1 && (fl & O_DSYNC); 
+        }
+    }
     return f;
 }
 
@@ -92,10 +389,16 @@ io61_file* io61_fdopen(int fd, int mode) {
 // io61_close(f)
 //    Closes the io61_file `f` and releases all its resources.
 
+static void io61_lock_stats_close(io61_file* f);
+static void io61_lock_profile_report(io61_file* f);
+
 int io61_close(io61_file* f) {
     io61_flush(f);
+    io61_lock_stats_close(f);
+    if (f->lockprof) io61_lock_profile_report(f);
     int r = close(f->fd);
     munmap(f->map, (f->size > 0) ? f->size : f->cbufsz);
+    if (f->pmap) munmap((void*) f->pmap, f->pmap_size);
     delete f;
     return r;
 }
@@ -219,7 +522,6 @@ int io61_writec(io61_file* f, int c) {
 
     io61_check_assertions(f); 
 
-    assert(!f->positioned);
     if (f->end_tag == f->tag + f->cbufsz)
     {
         if (io61_flush(f) < 0) return -1; 
@@ -248,7 +550,6 @@ ssize_t io61_write(io61_file* f, const unsigned char* buf, size_t sz) {
     std::unique_lock<std::mutex> lg(f->m); 
 
     io61_check_assertions(f);
-    assert(!f->positioned);
 
     size_t nwritten = 0; 
     // nwritten = write(f->fd, buf, sz); 
@@ -286,13 +587,19 @@ ssize_t io61_write(io61_file* f, const unsigned char* buf, size_t sz) {
 //    data cached for reading and seeks to the logical file position.
 
 static int io61_flush_dirty(io61_file* f);
-static int io61_flush_dirty_positioned(io61_file* f);
+static int io61_flush_psets(io61_file* f);
 static int io61_flush_clean(io61_file* f);
 
 int io61_flush(io61_file* f) {
-    if (f->dirty && f->positioned) {
-        return io61_flush_dirty_positioned(f);
-    } else if (f->dirty) {
+    if (f->psets && io61_flush_psets(f) == -1) {
+        return -1;
+    }
+    // stores to `f->pmap` are already in the page cache; wait for the
+    // disk only if the file was opened with O_SYNC or O_DSYNC
+    if (f->durable && msync(f->pmap, f->pmap_size, MS_SYNC) == -1) {
+        return -1;
+    }
+    if (f->dirty) {
         return io61_flush_dirty(f);
     } else {
         return io61_flush_clean(f);
@@ -319,7 +626,6 @@ int io61_seek(io61_file* f, off_t off) {
     off_t r = lseek(f->fd, (off_t) off, SEEK_SET);
     if (r == -1) return -1; 
     f->pos_tag = off; 
-    f->positioned = false; 
 
     if (f->mode == O_WRONLY)
     {
@@ -397,26 +703,40 @@ static int io61_flush_dirty(io61_file* f) {
     return 0;
 }
 
-static int io61_flush_dirty_positioned(io61_file* f) {
-    // Called when `f`Ã¢â‚¬â„¢s cache is dirty and positioned.
+static int io61_flush_pslot(io61_file* f, io61_pslot* s) {
+    // Called when positioned cache slot `s` is dirty, with its set locked.
     // Uses `pwrite`; does not change file position.
-    off_t flush_tag = f->tag;
-    while (flush_tag != f->end_tag) {
-        ssize_t nw = pwrite(f->fd, &f->cbuf[flush_tag - f->tag],
-                            f->end_tag - flush_tag, flush_tag);
+    off_t flush_tag = s->tag;
+    while (flush_tag != s->end_tag) {
+        ssize_t nw = pwrite(f->fd, &s->buf[flush_tag - s->tag],
+                            s->end_tag - flush_tag, flush_tag);
         if (nw >= 0) {
             flush_tag += nw;
         } else if (errno != EINTR && errno != EINVAL) {
             return -1;
         }
     }
-    f->dirty = false;
+    s->dirty = false;
+    return 0;
+}
+
+static int io61_flush_psets(io61_file* f) {
+    // Flushes every dirty slot of the positioned cache.
+    for (size_t i = 0; i != f->npsets; ++i) {
+        io61_pset* set = &f->psets[i];
+        std::unique_lock<std::mutex> lg(set->m);
+        for (auto& s : set->slots) {
+            if (s.dirty && io61_flush_pslot(f, &s) == -1) {
+                return -1;
+            }
+        }
+    }
     return 0;
 }
 
 static int io61_flush_clean(io61_file* f) {
     // Called when `f`Ã¢â‚¬â„¢s cache is clean.
-    if (!f->positioned && f->seekable) {
+    if (f->seekable) {
         if (lseek(f->fd, f->pos_tag, SEEK_SET) == -1) {
             return -1;
         }
@@ -435,22 +755,37 @@ static int io61_flush_clean(io61_file* f) {
 //
 //    This function can only be called when `f` was opened in read/write
 //    more (O_RDWR).
+//
+//    Offsets covered by the shared mapping are copied straight out of it
+//    without taking any mutex; io61_pwrite stores into the same mapping,
+//    so it always has the latest data. Other offsets go through the
+//    positioned cache.
 
-static int io61_pfill(io61_file* f, off_t off);
+static io61_pslot* io61_plookup(io61_file* f, io61_pset* set, off_t off);
 
 ssize_t io61_pread(io61_file* f, unsigned char* buf, size_t sz,
                    off_t off) {
-    // coarse-grained locking to ensure only one process can read from/write to the file at a given time
-    std::unique_lock<std::mutex> lg(f->m); 
+    if (off < f->pmap_size)
+    {
+        size_t ncopy = std::min(sz, (size_t) (f->pmap_size - off));
+        memcpy(buf, &f->pmap[off], ncopy);
+        return ncopy;
+    }
 
-    if (!f->positioned || off < f->tag || off >= f->end_tag) {
-        if (io61_pfill(f, off) == -1) {
-            return -1;
-        }
+    // only this block's set is locked
+    io61_pset* set = &f->psets[(off / io61_pslot::bufsz) % f->npsets];
+    std::unique_lock<std::mutex> lg(set->m);
+
+    io61_pslot* s = io61_plookup(f, set, off);
+    if (!s) {
+        return -1;
     }
-    size_t nleft = f->end_tag - off;
+    if (off >= s->end_tag) {
+        return 0;
+    }
+    size_t nleft = s->end_tag - off;
     size_t ncopy = std::min(sz, nleft);
-    memcpy(buf, &f->cbuf[off - f->tag], ncopy);
+    memcpy(buf, &s->buf[off - s->tag], ncopy);
     return ncopy;
 }
 
@@ -461,64 +796,513 @@ ssize_t io61_pread(io61_file* f, unsigned char* buf, size_t sz,
 //
 //    This function can only be called when `f` was opened in read/write
 //    more (O_RDWR).
+//
+//    Offsets covered by the shared mapping are stored into it without a
+//    system call or mutex (callers serialize conflicting writes with
+//    range locks). Other offsets go through the positioned cache.
 
 ssize_t io61_pwrite(io61_file* f, const unsigned char* buf, size_t sz,
                     off_t off) {
-    // coarse-grained locking to ensure only one process can read from/write to the file at a given time
-    std::unique_lock<std::mutex> lg(f->m); 
+    if (off < f->pmap_size)
+    {
+        size_t ncopy = std::min(sz, (size_t) (f->pmap_size - off));
+        memcpy(&f->pmap[off], buf, ncopy);
+        return ncopy;
+    }
 
-    if (!f->positioned || off < f->tag || off >= f->end_tag) {
-        if (io61_pfill(f, off) == -1) {
-            return -1;
-        }
+    // only this block's set is locked
+    io61_pset* set = &f->psets[(off / io61_pslot::bufsz) % f->npsets];
+    std::unique_lock<std::mutex> lg(set->m);
+
+    io61_pslot* s = io61_plookup(f, set, off);
+    if (!s) {
+        return -1;
+    }
+    off_t block_start = off - (off % s->bufsz);
+    // writing past the end of the file leaves a hole of zeroes
+    if (off > s->end_tag) {
+        memset(&s->buf[s->end_tag - s->tag], 0, off - s->end_tag);
+    }
+    size_t ncopy = std::min(sz, (size_t) (block_start + s->bufsz - off));
+    memcpy(&s->buf[off - s->tag], buf, ncopy);
+    s->end_tag = std::max(s->end_tag, (off_t) (off + ncopy));
+    s->dirty = true;
+
+    // other slots may need to know the file grew
+    off_t psize = f->psize;
+    while (psize < s->end_tag
+           && !f->psize.compare_exchange_weak(psize, s->end_tag)) {
     }
-    size_t nleft = f->end_tag - off;
-    size_t ncopy = std::min(sz, nleft);
-    memcpy(&f->cbuf[off - f->tag], buf, ncopy);
-    f->dirty = true;
     return ncopy;
 }
 
 
-// io61_pfill(f, off)
-//    Fill the single-slot cache with data including offset `off`.
-//    The handout code rounds `off` down to a multiple of 8192.
+// io61_plookup(f, set, off)
+//    Returns the slot of `set` holding the block containing `off`,
+//    filling the least recently used slot on a miss. Returns nullptr on
+//    error. A slot never covers mapped offsets, since those are stored
+//    in the mapping.
+//    Must be called with `set->m` held.
 
-static int io61_pfill(io61_file* f, off_t off) {
+static io61_pslot* io61_plookup(io61_file* f, io61_pset* set, off_t off) {
     assert(f->mode == O_RDWR);
-    if (f->dirty && io61_flush(f) == -1) {
-        return -1;
+    off_t block_start = off - (off % io61_pslot::bufsz);
+    off_t block_end = block_start + io61_pslot::bufsz;
+
+    io61_pslot* s = nullptr;
+    for (auto& x : set->slots) {
+        if (x.tag >= 0 && x.tag - (x.tag % x.bufsz) == block_start) {
+            s = &x;
+            break;
+        } else if (!s || x.used < s->used) {
+            s = &x;
+        }
     }
 
-    off = off - (off % 8192);
-    ssize_t nr = pread(f->fd, f->cbuf, f->cbufsz, off);
-    if (nr == -1) {
-        return -1;
+    if (s->tag < 0 || s->tag - (s->tag % s->bufsz) != block_start) {
+        // miss: replace `s`
+        if (s->dirty && io61_flush_pslot(f, s) == -1) {
+            return nullptr;
+        }
+        if (!s->buf) {
+            s->buf.reset(new unsigned char[s->bufsz]);
+        }
+        off_t start = std::max(block_start, f->pmap_size);
+        ssize_t nr = pread(f->fd, s->buf.get(), block_end - start, start);
+        if (nr == -1) {
+            s->tag = s->end_tag = -1;
+            return nullptr;
+        }
+        s->tag = start;
+        s->end_tag = start + nr;
     }
-    f->tag = off;
-    f->end_tag = off + nr;
-    f->positioned = true;
-    return 0;
+    s->used = ++set->clock;
+
+    // if other blocks' cached writes extend the file past this one, its
+    // unwritten part reads as zeroes
+    off_t zero_end = std::min(block_end, (off_t) f->psize);
+    if (s->end_tag < zero_end) {
+        memset(&s->buf[s->end_tag - s->tag], 0, zero_end - s->end_tag);
+        s->end_tag = zero_end;
+    }
+    return s;
 }
 
-bool is_overlap(io61_file* f, off_t start, off_t len)
+
+// RANGE LOCK HELPERS
+//    A range lock is recorded in every shard its range touches, and a
+//    thread holds those shards' mutexes, locked in index order, while it
+//    examines or changes the range.
+
+// number of range locks this thread holds, across all files
+static thread_local size_t nheld = 0;
+
+// waits-for graph, spanning all files: the blocked threads and their
+// edges. `deadlock_mutex` is only taken on blocking and waking paths,
+// and nests inside shard mutexes.
+static std::mutex deadlock_mutex;
+static std::unordered_map<std::thread::id, io61_waiter*> blocked_waiters;
+
+// io61_shard_guard
+//    Holds the mutexes of the shards covering one or more ranges. Bit
+//    `i` of `mask` is set if the guard covers shard `i`; mutexes are
+//    locked in index order.
+
+struct io61_shard_guard {
+    io61_file* f;
+    uint64_t mask = 0;
+    bool locked = false;
+
+    static_assert(io61_file::nshards <= 64);
+
+    io61_shard_guard(io61_file* f_, off_t start, off_t end)
+        : f(f_) {
+        add(start, end);
+        lock();
+    }
+    io61_shard_guard(io61_file* f_, const io61_range* first, const io61_range* last)
+        : f(f_) {
+        for (auto r = first; r != last; ++r) {
+            if (r->len > 0) add(r->start, r->start + r->len);
+        }
+        lock();
+    }
+    ~io61_shard_guard() {
+        if (locked) unlock();
+    }
+
+    void add(off_t start, off_t end) {
+        size_t lo = index(f, start), hi = index(f, end - 1);
+        mask |= (~uint64_t(0) >> (63 - hi)) & (~uint64_t(0) << lo);
+    }
+    void lock() {
+        for (uint64_t m = mask; m; m &= m - 1) f->shards[__builtin_ctzll(m)].m.lock();
+        locked = true;
+    }
+    void unlock() {
+        for (uint64_t m = mask; m; ) {
+            int i = 63 - __builtin_clzll(m);
+            f->shards[i].m.unlock();
+            m &= ~(uint64_t(1) << i);
+        }
+        locked = false;
+    }
+
+    static size_t index(io61_file* f, off_t off) {
+        return std::min((size_t) (off / f->shard_span), f->nshards - 1);
+    }
+};
+
+// is_overlap(f, start, len, locktype)
+//    Returns true if another thread holds a lock overlapping
+//    `[start, start + len)` that conflicts with a `locktype` request:
+//    shared locks conflict only with exclusive ones. Must be called with
+//    the range's shards locked.
+
+bool is_overlap(io61_file* f, off_t start, off_t len, int locktype)
 {
-    for (int i = start / f->chunk_sz; i * f->chunk_sz < start + len; i++)
-        if (f->nlocked[i] && f->owner[i] != std::this_thread::get_id()) return 1; 
-    
-    return 0; 
+    auto self = std::this_thread::get_id();
+    size_t lo = io61_shard_guard::index(f, start);
+    size_t hi = io61_shard_guard::index(f, start + len - 1);
+    for (size_t i = lo; i <= hi; ++i)
+    {
+        if (f->shards[i].locks.find(start, start + len, [&] (io61_range_lock* x) {
+                return x->owner != self
+                    && (locktype == LOCK_EX || x->locktype == LOCK_EX);
+            })) return true;
+    }
+    return false;
+}
+
+// must_yield(f, start, len, locktype, ticket)
+//    Returns true if a `locktype` request on `[start, start + len)` must
+//    wait behind a conflicting request that blocked before it (one with a
+//    smaller ticket). This keeps a stream of readers from starving a
+//    writer, and a stream of writers from starving readers. A thread that
+//    already holds locks never yields, since the request it would yield
+//    to might be waiting for those locks. Must be called with the range's
+//    shards locked.
+
+bool must_yield(io61_file* f, off_t start, off_t len, int locktype,
+                unsigned long ticket = ULONG_MAX)
+{
+    if (nheld != 0) return false;
+    auto self = std::this_thread::get_id();
+    size_t lo = io61_shard_guard::index(f, start);
+    size_t hi = io61_shard_guard::index(f, start + len - 1);
+    for (size_t i = lo; i <= hi; ++i)
+    {
+        if (f->shards[i].waiting.find(start, start + len, [&] (io61_range_lock* x) {
+                return x->owner != self && x->ticket < ticket
+                    && (locktype == LOCK_EX || x->locktype == LOCK_EX);
+            })) return true;
+    }
+    return false;
+}
+
+// lock_region(f, start, len, locktype)
+//    Records a lock on `[start, start + len)` held by this thread. Must
+//    be called with the range's shards locked.
+
+void lock_region(io61_file* f, off_t start, off_t len, int locktype)
+{
+    size_t lo = io61_shard_guard::index(f, start);
+    size_t hi = io61_shard_guard::index(f, start + len - 1);
+    for (size_t i = lo; i <= hi; ++i)
+    {
+        io61_range_lock* l = f->shards[i].locks.alloc();
+        l->start = start;
+        l->end = start + len;
+        l->owner = std::this_thread::get_id();
+        l->locktype = locktype;
+        if (f->lockprof) l->acquired_at = monotonic_timestamp();
+        f->shards[i].locks.insert(l);
+
+        // requests already blocked on this range now wait for us too
+        f->shards[i].waiting.for_each(start, start + len, [&] (io61_range_lock* w) {
+            if (w->owner != l->owner
+                && (locktype == LOCK_EX || w->locktype == LOCK_EX))
+            {
+                std::unique_lock<std::mutex> dl(deadlock_mutex);
+                auto& edges = w->waiter->waits_for;
+                if (std::find(edges.begin(), edges.end(), l->owner) == edges.end())
+                    edges.push_back(l->owner);
+            }
+        });
+    }
+    ++nheld;
+}
+
+// erase_region(f, start, end, locktype)
+//    Removes one of this thread's locks on exactly `[start, end)` from
+//    every shard it was recorded in. Returns false if there is none.
+//    Must be called with the range's shards locked.
+
+bool erase_region(io61_file* f, off_t start, off_t end, int locktype = -1)
+{
+    auto self = std::this_thread::get_id();
+    size_t lo = io61_shard_guard::index(f, start);
+    size_t hi = io61_shard_guard::index(f, end - 1);
+    for (size_t i = lo; i <= hi; ++i)
+    {
+        io61_lock_tree& locks = f->shards[i].locks;
+        io61_range_lock* l = locks.find(start, end, [&] (io61_range_lock* x) {
+            return x->owner == self && x->start == start && x->end == end
+                && (locktype == -1 || x->locktype == locktype);
+        });
+        if (!l)
+        {
+            assert(i == lo);
+            return false;
+        }
+        if (f->lockprof && i == lo)
+        {
+            // a trimmed lock's remaining pieces count as new locks
+            io61_lock_profile& p = f->shards[i].profile[{start, end}];
+            double held = monotonic_timestamp() - l->acquired_at;
+            p.hold += held;
+            p.max_hold = std::max(p.max_hold, held);
+        }
+        locktype = l->locktype;
+        locks.erase(l);
+        locks.release(l);
+    }
+    --nheld;
+    return true;
+}
+
+// trim_region(f, start, len)
+//    Trims every lock this thread holds to exclude `[start, start + len)`.
+//    Returns -1 if this thread held nothing there. Must be called with
+//    every shard locked, since trimmed locks may extend anywhere.
+
+int trim_region(io61_file* f, off_t start, off_t len)
+{
+    auto self = std::this_thread::get_id();
+    off_t end = start + len;
+    size_t lo = io61_shard_guard::index(f, start);
+    size_t hi = io61_shard_guard::index(f, end - 1);
+    int r = -1;
+    for (size_t i = lo; i <= hi; ++i)
+    {
+        io61_range_lock* l;
+        while ((l = f->shards[i].locks.find(start, end, [&] (io61_range_lock* x) {
+                    return x->owner == self;
+                })))
+        {
+            io61_range_lock old = *l;
+            erase_region(f, old.start, old.end, old.locktype);
+            if (old.end > end) lock_region(f, end, old.end - end, old.locktype);
+            if (old.start < start) lock_region(f, old.start, start - old.start, old.locktype);
+            r = 0;
+        }
+    }
+    return r;
 }
 
-void lock_region(io61_file* f, off_t start, off_t len)
+// add_waiter(f, start, len, locktype, ticket, waiter)
+//    Records a blocked request in the range's shards.
+
+void add_waiter(io61_file* f, off_t start, off_t len, int locktype,
+                unsigned long ticket, io61_waiter* waiter)
 {
-    for (int i = start / f->chunk_sz; i * f->chunk_sz < start + len; i++)
+    size_t lo = io61_shard_guard::index(f, start);
+    size_t hi = io61_shard_guard::index(f, start + len - 1);
+    for (size_t i = lo; i <= hi; ++i)
     {
-        assert(f->nlocked[i] == 0 || f->owner[i] == std::this_thread::get_id());
-        f->nlocked[i]++; 
-        f->owner[i] = std::this_thread::get_id(); 
+        io61_range_lock* w = f->shards[i].waiting.alloc();
+        w->start = start;
+        w->end = start + len;
+        w->owner = std::this_thread::get_id();
+        w->locktype = locktype;
+        w->ticket = ticket;
+        w->waiter = waiter;
+        f->shards[i].waiting.insert(w);
     }
 }
 
+// remove_waiter(f, start, len, waiter)
+//    Removes a blocked request recorded by add_waiter.
+
+void remove_waiter(io61_file* f, off_t start, off_t len, io61_waiter* waiter)
+{
+    size_t lo = io61_shard_guard::index(f, start);
+    size_t hi = io61_shard_guard::index(f, start + len - 1);
+    for (size_t i = lo; i <= hi; ++i)
+    {
+        io61_lock_tree& waiting = f->shards[i].waiting;
+        io61_range_lock* w = waiting.find(start, start + len, [&] (io61_range_lock* x) {
+            return x->waiter == waiter && x->start == start && x->end == start + len;
+        });
+        waiting.erase(w);
+        waiting.release(w);
+    }
+}
+
+// wake_waiters(f, start, len)
+//    Wakes the blocked requests that overlap `[start, start + len)`.
+//    Their waits-for edges may name the thread that released the range,
+//    so they are cleared; each woken request recomputes its edges if it
+//    must keep waiting.
+
+void wake_waiters(io61_file* f, off_t start, off_t len)
+{
+    std::unique_lock<std::mutex> dl(deadlock_mutex, std::defer_lock);
+    size_t lo = io61_shard_guard::index(f, start);
+    size_t hi = io61_shard_guard::index(f, start + len - 1);
+    for (size_t i = lo; i <= hi; ++i)
+    {
+        f->shards[i].waiting.for_each(start, start + len, [&] (io61_range_lock* w) {
+            if (!dl.owns_lock()) dl.lock();
+            w->waiter->waits_for.clear();
+            w->waiter->signal();
+        });
+    }
+}
+
+// would_deadlock(f, ranges, n, locktype, waiter)
+//    Records the waits-for edges of this thread's blocked request
+//    `waiter` on `ranges[0..n-1]`, then returns true if the graph
+//    leads from this thread back to itself. Any cycle must pass through
+//    the edges just recorded, so a deadlock is always detected by the
+//    request that completes it. Must be called with the ranges' shards
+//    locked.
+
+bool would_deadlock(io61_file* f, const io61_range* ranges, size_t n,
+                    int locktype, io61_waiter* waiter)
+{
+    auto self = std::this_thread::get_id();
+    std::vector<std::thread::id> holders;
+    for (size_t r = 0; r != n; ++r)
+    {
+        off_t start = ranges[r].start, end = start + ranges[r].len;
+        if (end == start) continue;
+        size_t lo = io61_shard_guard::index(f, start);
+        size_t hi = io61_shard_guard::index(f, end - 1);
+        for (size_t i = lo; i <= hi; ++i)
+        {
+            f->shards[i].locks.for_each(start, end, [&] (io61_range_lock* x) {
+                if (x->owner != self
+                    && (locktype == LOCK_EX || x->locktype == LOCK_EX)
+                    && std::find(holders.begin(), holders.end(), x->owner) == holders.end())
+                    holders.push_back(x->owner);
+            });
+        }
+    }
+
+    std::unique_lock<std::mutex> dl(deadlock_mutex);
+    waiter->waits_for = std::move(holders);
+    blocked_waiters[self] = waiter;
+
+    waiter->holder_blocked = false;
+    for (auto t : waiter->waits_for)
+    {
+        if (blocked_waiters.count(t)) waiter->holder_blocked = true;
+    }
+
+    // depth-first search from this thread
+    std::vector<std::thread::id> stack(waiter->waits_for);
+    std::vector<std::thread::id> visited;
+    while (!stack.empty())
+    {
+        std::thread::id t = stack.back();
+        stack.pop_back();
+        if (t == self) return true;
+        if (std::find(visited.begin(), visited.end(), t) != visited.end()) continue;
+        visited.push_back(t);
+        auto it = blocked_waiters.find(t);
+        if (it != blocked_waiters.end())
+            stack.insert(stack.end(), it->second->waits_for.begin(),
+                         it->second->waits_for.end());
+    }
+    return false;
+}
+
+// profile_lock(f, start, len, waited, wait)
+//    Records a granted lock on `[start, start + len)` in the profile,
+//    after waiting `wait` seconds if `waited`. Must be called with the
+//    range's shards locked.
+
+void profile_lock(io61_file* f, off_t start, off_t len, bool waited, double wait)
+{
+    io61_lock_shard& sh = f->shards[io61_shard_guard::index(f, start)];
+    io61_lock_profile& p = sh.profile[{start, start + len}];
+    ++p.nacquired;
+    if (waited)
+    {
+        ++p.ncontended;
+        p.wait += wait;
+        p.max_wait = std::max(p.max_wait, wait);
+    }
+}
+
+// spin_wait(f, waiter)
+//    Spins, with exponential backoff, until `waiter` is signaled or
+//    `f->spin_limit` pauses have passed. Returns true if it was signaled.
+//    Critical sections are usually short, so a brief spin often avoids
+//    the cost of parking and waking; but spinning is pointless if a
+//    conflicting holder is itself blocked. The limit tracks twice the
+//    length of recent successful spins, and shrinks when spins fail.
+
+static inline void io61_pause() {
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#elif defined(__aarch64__)
+    asm volatile("yield");
+#endif
+}
+
+bool spin_wait(io61_file* f, io61_waiter* waiter)
+{
+    unsigned limit = f->spin_limit.load(std::memory_order_relaxed);
+    if (limit == 0 || waiter->holder_blocked) return false;
+
+    unsigned spent = 0;
+    for (unsigned delay = 1; spent < limit; delay = std::min(delay * 2, 64U))
+    {
+        for (unsigned i = 0; i != delay; ++i) io61_pause();
+        spent += delay;
+        if (waiter->signaled.load(std::memory_order_acquire))
+        {
+            int adjust = ((int) (2 * spent) - (int) limit) / 8;
+            f->spin_limit.store(std::clamp<int>(limit + adjust, io61_spin_min, io61_spin_max),
+                                std::memory_order_relaxed);
+            return true;
+        }
+    }
+    f->spin_limit.store(std::max(limit - limit / 4, io61_spin_min),
+                        std::memory_order_relaxed);
+    return false;
+}
+
+// is_blocked(f, ranges, n, locktype, ticket)
+//    Returns true if any of `ranges[0..n-1]` overlaps a conflicting lock
+//    or must yield to an earlier request. Must be called with the
+//    ranges' shards locked.
+
+bool is_blocked(io61_file* f, const io61_range* ranges, size_t n,
+                int locktype, unsigned long ticket = ULONG_MAX)
+{
+    for (size_t r = 0; r != n; ++r)
+    {
+        if (ranges[r].len > 0
+            && (is_overlap(f, ranges[r].start, ranges[r].len, locktype)
+                || must_yield(f, ranges[r].start, ranges[r].len, locktype, ticket)))
+            return true;
+    }
+    return false;
+}
+
+// unblock_waiter(waiter)
+//    Removes this thread's blocked request from the waits-for graph.
+
+void unblock_waiter(io61_waiter* waiter)
+{
+    std::unique_lock<std::mutex> dl(deadlock_mutex);
+    waiter->waits_for.clear();
+    blocked_waiters.erase(std::this_thread::get_id());
+}
+
 // FILE LOCKING FUNCTIONS
 
 // io61_try_lock(f, start, len, locktype)
@@ -533,42 +1317,138 @@ int io61_try_lock(io61_file* f, off_t start, off_t len, int locktype) {
     assert(start >= 0 && len >= 0);
     assert(locktype == LOCK_EX || locktype == LOCK_SH);
     if (len == 0) return 0;
-    
-    // try to grab the lock
-    std::unique_lock<std::mutex> lg(f->m); 
 
-    // lock acquired
+    // lock only the shards covering the region
+    io61_shard_guard g(f, start, start + len);
+
     // first check if entire region can be locked
-    if (is_overlap(f, start, len)) return -1; 
+    if (is_overlap(f, start, len, locktype)
+        || must_yield(f, start, len, locktype))
+    {
+        if (f->lockprof)
+            ++f->shards[io61_shard_guard::index(f, start)].profile[{start, start + len}].ntryfail;
+        return -1;
+    }
 
     // entire region is free
-    lock_region(f, start, len); 
-    return 0; 
+    lock_region(f, start, len, locktype);
+    if (f->lockprof) profile_lock(f, start, len, false, 0);
+    return 0;
 }
 
 
 // io61_lock(f, start, len, locktype)
 //    Acquire a lock on offsets `[start, len)` in file `f`.
 //    `locktype` must be `LOCK_SH`, which requests a shared lock,
-//    or `LOCK_EX`, which requests an exclusive lock.
+//    or `LOCK_EX`, which requests an exclusive lock. Any number of
+//    threads may share a region. Conflicting requests are granted in
+//    the order they blocked, so neither readers nor writers starve.
 //
 //    Returns 0 if the lock was acquired and -1 on error. Blocks until
-//    the lock can be acquired; the -1 return value is reserved for true
-//    error conditions, such as EDEADLK (a deadlock was detected).
+//    the lock can be acquired, unless waiting would deadlock: if a thread
+//    holding a conflicting lock is itself waiting, directly or through
+//    other threads, for a lock this thread holds, returns -1 with errno
+//    set to EDEADLK. The caller should then release its locks and retry.
 
 int io61_lock(io61_file* f, off_t start, off_t len, int locktype) {
-    assert(start >= 0 && len >= 0);
+    io61_range r = {start, len};
+    return io61_lock_many(f, &r, 1, locktype);
+}
+
+
+// io61_lock_many(f, ranges, n, locktype)
+//    Acquire `locktype` locks on every range in `ranges[0..n-1]`, all or
+//    nothing: the call blocks until every range is free, then locks them
+//    all at once. Each range is a separate lock, released by its own
+//    io61_unlock. Since no range is held while others are awaited,
+//    callers need no lock ordering among the ranges.
+//
+//    Returns 0 if the locks were acquired and -1 on error, as io61_lock.
+//    On error, none of the ranges are locked.
+
+int io61_lock_many(io61_file* f, const io61_range* ranges, size_t n,
+                   int locktype) {
     assert(locktype == LOCK_EX || locktype == LOCK_SH);
-    if (len == 0) return 0; 
+    for (size_t i = 0; i != n; ++i) {
+        assert(ranges[i].start >= 0 && ranges[i].len >= 0);
+    }
 
-    // try to grab the lock
-    std::unique_lock<std::mutex> lg(f->m); 
+    // lock only the shards covering the ranges, once for all of them
+    io61_shard_guard g(f, ranges, ranges + n);
+    if (!g.mask) return 0;
+
+    bool waited = false;
+    double wait_start = 0;
+    if (is_blocked(f, ranges, n, locktype))
+    {
+        waited = true;
+        if (f->lockprof) wait_start = monotonic_timestamp();
+        // blocked requests take a ticket so later arrivals yield to them,
+        // and wait on their own io61_waiter so only unlocks of
+        // overlapping ranges wake them
+        io61_waiter waiter;
+        unsigned long ticket = f->next_ticket++;
+        f->ncontended.fetch_add(1, std::memory_order_relaxed);
+        for (size_t i = 0; i != n; ++i)
+        {
+            if (ranges[i].len > 0)
+                add_waiter(f, ranges[i].start, ranges[i].len, locktype, ticket, &waiter);
+        }
 
-    // repeated check if the entire region can be locked
-    while (is_overlap(f, start, len)) f->cv.wait(lg); 
+        // repeated check if every range can be locked; unlocks that
+        // signal `waiter` hold one of our shards, so none can be missed
+        // between the check and the wait
+        do
+        {
+            if (would_deadlock(f, ranges, n, locktype, &waiter))
+            {
+                // later requests may be yielding to this one
+                unblock_waiter(&waiter);
+                for (size_t i = 0; i != n; ++i)
+                {
+                    if (ranges[i].len == 0) continue;
+                    remove_waiter(f, ranges[i].start, ranges[i].len, &waiter);
+                    wake_waiters(f, ranges[i].start, ranges[i].len);
+                }
+                f->ndeadlocks.fetch_add(1, std::memory_order_relaxed);
+                errno = EDEADLK;
+                return -1;
+            }
+            waiter.signaled = false;
+            g.unlock();
+            if (spin_wait(f, &waiter))
+            {
+                f->nspins.fetch_add(1, std::memory_order_relaxed);
+            }
+            else
+            {
+                f->nparks.fetch_add(1, std::memory_order_relaxed);
+                waiter.parked = true;
+                {
+                    std::unique_lock<std::mutex> wl(waiter.m);
+                    while (!waiter.signaled) waiter.cv.wait(wl);
+                }
+                waiter.parked = false;
+            }
+            g.lock();
+        } while (is_blocked(f, ranges, n, locktype, ticket));
+
+        unblock_waiter(&waiter);
+        for (size_t i = 0; i != n; ++i)
+        {
+            if (ranges[i].len > 0)
+                remove_waiter(f, ranges[i].start, ranges[i].len, &waiter);
+        }
+    }
 
-    // entire region is free
-    lock_region(f, start, len); 
+    // every range is free
+    double wait = waited && f->lockprof ? monotonic_timestamp() - wait_start : 0;
+    for (size_t i = 0; i != n; ++i)
+    {
+        if (ranges[i].len == 0) continue;
+        lock_region(f, ranges[i].start, ranges[i].len, locktype);
+        if (f->lockprof) profile_lock(f, ranges[i].start, ranges[i].len, waited, wait);
+    }
     return 0;
 }
 
@@ -576,24 +1456,101 @@ int io61_lock(io61_file* f, off_t start, off_t len, int locktype) {
 // io61_unlock(f, start, len)
 //    Release the lock on offsets `[start,len)` in file `f`.
 //    Returns 0 on success and -1 on error.
+//
+//    A lock on exactly that range is released whole; otherwise, every
+//    lock this thread holds is trimmed to exclude the range.
 
 int io61_unlock(io61_file* f, off_t start, off_t len) {
     assert(start >= 0 && len >= 0);
     if (len == 0) return 0;
-    
-    // try to grab the lock
-    std::unique_lock<std::mutex> lg(f->m); 
 
-    // lock acquired; remove all locks
-    for (int i = start / f->chunk_sz; i * f->chunk_sz < start + len; i++)
+    // lock only the shards covering the region
+    io61_shard_guard g(f, start, start + len);
+
+    if (!erase_region(f, start, start + len))
     {
-        assert(f->nlocked[i] && f->owner[i] == std::this_thread::get_id()); 
-        f->nlocked[i]--; 
+        // trimmed locks may extend into any shard, so lock them all
+        g.unlock();
+        io61_shard_guard all(f, 0, f->shard_span * f->nshards);
+        if (trim_region(f, start, len) == -1)
+        {
+            errno = ENOLCK;
+            return -1;
+        }
+        wake_waiters(f, start, len);
+        return 0;
     }
 
-    // notify changes
-    f->cv.notify_all(); 
-    return 0; 
+    // wake only the requests waiting on the released range
+    wake_waiters(f, start, len);
+    return 0;
+}
+
+
+
+// io61_lock_stats(f)
+//    Returns the range lock counters for `f`, or the totals for all
+//    closed files if `f == nullptr`. io61_lock_stats_close adds `f`'s
+//    counters to those totals.
+
+static io61_lock_statistics io61_closed_lock_stats;
+static std::mutex io61_closed_lock_stats_mutex;
+
+io61_lock_statistics io61_lock_stats(io61_file* f) {
+    if (!f) {
+        std::unique_lock<std::mutex> lg(io61_closed_lock_stats_mutex);
+        return io61_closed_lock_stats;
+    }
+    io61_lock_statistics st;
+    st.ncontended = f->ncontended;
+    st.nspins = f->nspins;
+    st.nparks = f->nparks;
+    st.ndeadlocks = f->ndeadlocks;
+    return st;
+}
+
+static void io61_lock_stats_close(io61_file* f) {
+    io61_lock_statistics st = io61_lock_stats(f);
+    std::unique_lock<std::mutex> lg(io61_closed_lock_stats_mutex);
+    io61_lock_statistics& t = io61_closed_lock_stats;
+    t.ncontended += st.ncontended;
+    t.nspins += st.nspins;
+    t.nparks += st.nparks;
+    t.ndeadlocks += st.ndeadlocks;
+}
+
+
+
+// io61_lock_profile_report(f)
+//    Prints the `f->lockprof` ranges of `f` with the most total wait time
+//    to standard error. Ranges that wait often relative to how often they
+//    are locked are hotspots; a high contended fraction with short holds
+//    suggests a lock convoy.
+
+static void io61_lock_profile_report(io61_file* f) {
+    std::vector<std::pair<std::pair<off_t, off_t>, io61_lock_profile>> ranges;
+    for (auto& sh : f->shards) {
+        std::unique_lock<std::mutex> lg(sh.m);
+        ranges.insert(ranges.end(), sh.profile.begin(), sh.profile.end());
+    }
+    size_t n = std::min(ranges.size(), f->lockprof);
+    std::partial_sort(ranges.begin(), ranges.begin() + n, ranges.end(),
+                      [] (const auto& a, const auto& b) {
+                          return a.second.wait > b.second.wait;
+                      });
+
+    fprintf(stderr, "io61 lock profile (fd %d): top %zu of %zu ranges by wait time\n",
+            f->fd, n, ranges.size());
+    fprintf(stderr, "%12s %8s %10s %10s %8s %12s %10s %12s %10s\n",
+            "start", "len", "acquired", "contended", "tryfail",
+            "wait_ms", "maxwait_ms", "hold_ms", "maxhold_ms");
+    for (size_t i = 0; i != n; ++i) {
+        auto& [range, p] = ranges[i];
+        fprintf(stderr, "%12lld %8lld %10lu %10lu %8lu %12.3f %10.3f %12.3f %10.3f\n",
+                (long long) range.first, (long long) (range.second - range.first),
+                p.nacquired, p.ncontended, p.ntryfail,
+                p.wait * 1000, p.max_wait * 1000, p.hold * 1000, p.max_hold * 1000);
+    }
 }
 
 
@@ -32,10 +32,32 @@ ssize_t io61_pread(io61_file* f, unsigned char* buf, size_t sz,
 ssize_t io61_pwrite(io61_file* f, const unsigned char* buf, size_t sz,
                     off_t off);
 
+struct io61_range {                     // offsets `[start, start + len)`
+    off_t start;
+    off_t len;
+};
+
 int io61_try_lock(io61_file* f, off_t start, off_t len, int locktype);
 int io61_lock(io61_file* f, off_t start, off_t len, int locktype);
+int io61_lock_many(io61_file* f, const io61_range* ranges, size_t n,
+                   int locktype);
 int io61_unlock(io61_file* f, off_t start, off_t len);
 
+// io61_lock_statistics, io61_lock_stats(f)
+//    Range lock counters. `io61_lock_stats(f)` returns the counts for `f`
+//    so far; `io61_lock_stats(nullptr)` returns the totals for all files
+//    closed so far. A contended request waits one or more times; each
+//    wait ends either while spinning or after parking.
+
+struct io61_lock_statistics {
+    unsigned long ncontended = 0;       // lock requests that had to wait
+    unsigned long nspins = 0;           // waits that ended while spinning
+    unsigned long nparks = 0;           // waits that slept until woken
+    unsigned long ndeadlocks = 0;       // requests failed with EDEADLK
+};
+
+io61_lock_statistics io61_lock_stats(io61_file* f);
+
 int io61_flush(io61_file* f);
 
 int fd_open_check(const char* filename, int mode);
@@ -67,6 +89,7 @@ struct io61_args {
     int nthreads = 1;                   // `-j`: number of threads
     int ndistinguished_threads = 0;     // `-J`: # distinguished threads
     size_t noperations = 0;             // `-n`: number of operations
+    bool optimistic = false;            // `-O`: optimistic transactions
 
     explicit io61_args(const char* opts, size_t block_size = 0);
 
@@ -0,0 +1,79 @@
+#! /usr/bin/perl -w
+
+# scale.pl
+#    This program measures how an ftx program scales with thread count.
+#    It runs the program with each thread count, splitting a fixed
+#    number of operations evenly among the threads, and prints one CSV
+#    record per thread count with throughput and speedup over the first.
+#
+#    Parameters are given as NAME=VALUE arguments (or environment
+#    variables):
+#      PROGRAM    program to run (default: ftxxfer)
+#      ARGS       extra program arguments, such as -O (default: none)
+#      THREADS    comma-separated thread counts (default: 1,2,4,8,16,32,64)
+#      NOPS       total operations per run (default: 64000)
+#      TRIALS     runs per thread count; the fastest is reported (default: 3)
+#      FILE       account database (default: accounts.fdb)
+#
+#    Example: perl scale.pl PROGRAM=ftxrocket THREADS=1,4,16 NOPS=32000
+#    Compare optimistic transactions with: perl scale.pl PROGRAM=ftxrocket ARGS=-O
+
+use POSIX;
+
+my %param;
+foreach my $arg (@ARGV) {
+    if ($arg =~ /\A([A-Z]+)=(.*)\z/s) {
+        $param{$1} = $2;
+    } else {
+        die "Usage: perl scale.pl [NAME=VALUE]...\n";
+    }
+}
+
+sub param ($$) {
+    my ($name, $default) = @_;
+    return $param{$name} if exists($param{$name});
+    return $ENV{$name} if exists($ENV{$name}) && $ENV{$name} ne "";
+    return $default;
+}
+
+my $PROGRAM = param("PROGRAM", "ftxxfer");
+my $ARGS = param("ARGS", "");
+my @THREADS = split(/[\s,]+/, param("THREADS", "1,2,4,8,16,32,64"));
+my $NOPS = param("NOPS", 64000);
+my $TRIALS = param("TRIALS", 3);
+my $FILE = param("FILE", "accounts.fdb");
+
+die "scale.pl: bad program $PROGRAM\n" if $PROGRAM !~ /\Aftx\w+\z/;
+die "scale.pl: bad arguments $ARGS\n" if $ARGS !~ /\A[-\w\s]*\z/;
+system("make", "-s", $PROGRAM) == 0 or die "scale.pl: build failed\n";
+
+
+# run_one(nthreads)
+#    Runs the program once and returns [operations, CPU time, real time]
+#    parsed from its report.
+
+sub run_one ($) {
+    my ($nthreads) = @_;
+    my $nops = POSIX::ceil($NOPS / $nthreads);
+    my $report = `./$PROGRAM $ARGS -j $nthreads -n $nops $FILE 2>&1`;
+    if ($? != 0
+        || $report !~ /(\d+) operations?, .*?([\d.]+)s CPU time, ([\d.]+)s real time/) {
+        die "scale.pl: ./$PROGRAM -j $nthreads failed:\n$report";
+    }
+    return [$1, $2, $3];
+}
+
+print "threads,operations,cpu,real,opspersec,speedup\n";
+my $base;
+foreach my $nthreads (@THREADS) {
+    my $best;
+    for (my $trial = 0; $trial < $TRIALS; ++$trial) {
+        my $r = run_one($nthreads);
+        $best = $r if !defined($best) || $r->[2] < $best->[2];
+    }
+    my ($ops, $cpu, $real) = @$best;
+    my $rate = $real > 0 ? $ops / $real : 0;
+    $base = $rate if !defined($base);
+    printf "%d,%d,%.6f,%.6f,%.0f,%.2f\n", $nthreads, $ops, $cpu, $real,
+        $rate, $base > 0 ? $rate / $base : 0;
+}